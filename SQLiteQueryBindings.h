@@ -0,0 +1,161 @@
+//
+// SQLiteQueryBindings.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// Type dispatched parameter binding from arrays, dictionaries and tagged C values
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+typedef NS_ENUM(NSInteger, SQLiteQueryBindType) {
+    SQLiteQueryBindTypeNull,
+    SQLiteQueryBindTypeInt64,
+    SQLiteQueryBindTypeDouble,
+    SQLiteQueryBindTypeText,        // utf8 buffer owned by the caller, bound SQLITE_STATIC
+    SQLiteQueryBindTypeBlob,        // buffer owned by the caller, bound SQLITE_STATIC
+    SQLiteQueryBindTypeInt64Array,  // sqlite3_int64 array bound as JSON array text for 'IN (SELECT value FROM json_each(?))'
+    SQLiteQueryBindTypeDoubleArray  // finite double array, as SQLiteQueryBindTypeInt64Array
+};
+
+// tagged parameter value, build with the SQLiteQueryBind* functions below
+typedef struct {
+    SQLiteQueryBindType type;
+    union {
+        sqlite3_int64 int64Value;
+        double doubleValue;
+        struct {
+            const void *bytes;
+            int length;
+        } buffer;
+        struct {
+            const void *values;
+            int count;
+        } array;
+    };
+} SQLiteQueryBindValue;
+
+static inline SQLiteQueryBindValue SQLiteQueryBindNull(void) {
+    SQLiteQueryBindValue value;
+    value.type = SQLiteQueryBindTypeNull;
+    value.int64Value = 0;
+    return value;
+}
+
+static inline SQLiteQueryBindValue SQLiteQueryBindInt64(sqlite3_int64 int64Value) {
+    SQLiteQueryBindValue value;
+    value.type = SQLiteQueryBindTypeInt64;
+    value.int64Value = int64Value;
+    return value;
+}
+
+static inline SQLiteQueryBindValue SQLiteQueryBindDouble(double doubleValue) {
+    SQLiteQueryBindValue value;
+    value.type = SQLiteQueryBindTypeDouble;
+    value.doubleValue = doubleValue;
+    return value;
+}
+
+// length -1 reads text up to the nul terminator
+static inline SQLiteQueryBindValue SQLiteQueryBindText(const char *text, int length) {
+    SQLiteQueryBindValue value;
+    value.type = SQLiteQueryBindTypeText;
+    value.buffer.bytes = text;
+    value.buffer.length = length;
+    return value;
+}
+
+static inline SQLiteQueryBindValue SQLiteQueryBindBlob(const void *bytes, int length) {
+    SQLiteQueryBindValue value;
+    value.type = SQLiteQueryBindTypeBlob;
+    value.buffer.bytes = bytes;
+    value.buffer.length = length;
+    return value;
+}
+
+static inline SQLiteQueryBindValue SQLiteQueryBindInt64Array(const sqlite3_int64 *values, int count) {
+    SQLiteQueryBindValue value;
+    value.type = SQLiteQueryBindTypeInt64Array;
+    value.array.values = values;
+    value.array.count = count;
+    return value;
+}
+
+static inline SQLiteQueryBindValue SQLiteQueryBindDoubleArray(const double *values, int count) {
+    SQLiteQueryBindValue value;
+    value.type = SQLiteQueryBindTypeDoubleArray;
+    value.array.values = values;
+    value.array.count = count;
+    return value;
+}
+
+/**
+ binds a tagged value, text and blob buffers must stay valid until the statement is reset
+ 
+ arrays are always bound as JSON array text, like NSArray in SQLiteQueryBindObject, query with 'IN (SELECT value FROM json_each(?))'.
+ the text is copied so arrays need not outlive the bind
+ 
+ @param statement prepared statement
+ @param paramIndex param index, starts at 1
+ @param value tagged value
+ 
+ @return sqlite result of the bind, SQLITE_MISMATCH for a nan or infinite double in an array
+ */
+int SQLiteQueryBindTaggedValue(sqlite3_stmt *statement, int paramIndex, const SQLiteQueryBindValue *value);
+
+/**
+ binds an object by type: NSNumber int64|double, NSString text, NSData blob, NSNull or nil null,
+ NSArray JSON array text for 'IN (SELECT value FROM json_each(?))'
+ 
+ text and blobs are bound SQLITE_TRANSIENT, sqlite copies them so value need not outlive the bind
+ 
+ @param statement prepared statement
+ @param paramIndex param index, starts at 1
+ @param value value to bind
+ 
+ @return sqlite result of the bind, SQLITE_MISMATCH for an unsupported type, an unsigned NSNumber above INT64_MAX
+ or an NSArray that is not valid JSON, ie holding nan or infinity
+ */
+int SQLiteQueryBindObject(sqlite3_stmt *statement, int paramIndex, id value);
+
+/**
+ binds params to a statement
+ 
+ @param statement prepared statement
+ @param params NSArray bound to params 1..n in order or NSDictionary of name -> value. names may omit the ':' '@' '$' prefix
+ 
+ @return SQLITE_OK or the first failed bind, SQLITE_RANGE for an unknown name
+ */
+int SQLiteQueryBindParams(sqlite3_stmt *statement, id params);
+
+/**
+ binds count tagged values to params 1..count
+ 
+ @param statement prepared statement
+ @param values tagged values
+ @param count number of values
+ 
+ @return SQLITE_OK or the first failed bind
+ */
+int SQLiteQueryBindTaggedValues(sqlite3_stmt *statement, const SQLiteQueryBindValue *values, int count);
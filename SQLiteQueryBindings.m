@@ -0,0 +1,162 @@
+//
+// SQLiteQueryBindings.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryBindings.h"
+
+// JSON array text of count values for json_each, SQLITE_TRANSIENT since the text is built here
+static int SQLiteQueryBindJSONArray(sqlite3_stmt *statement, int paramIndex, const SQLiteQueryBindValue *value) {
+    NSMutableString *json = [[NSMutableString alloc] initWithString:@"["];
+    
+    for(int i = 0; i < value->array.count; ++i) {
+        if(i > 0) {
+            [json appendString:@","];
+        }
+        if(value->type == SQLiteQueryBindTypeInt64Array) {
+            [json appendFormat:@"%lld", ((const sqlite3_int64 *)value->array.values)[i]];
+        }
+        else {
+            // json has no nan or infinity, json_each would fail on the whole array
+            double doubleValue = ((const double *)value->array.values)[i];
+            if(!isfinite(doubleValue)) {
+                NSLog(@"[SQLITE] Invalid bind array value %g at %d", doubleValue, i);
+                return SQLITE_MISMATCH;
+            }
+            [json appendFormat:@"%.17g", doubleValue];
+        }
+    }
+    [json appendString:@"]"];
+    
+    return sqlite3_bind_text(statement, paramIndex, [json UTF8String], -1, SQLITE_TRANSIENT);
+}
+
+int SQLiteQueryBindTaggedValue(sqlite3_stmt *statement, int paramIndex, const SQLiteQueryBindValue *value) {
+    switch(value->type) {
+        case SQLiteQueryBindTypeNull:
+            return sqlite3_bind_null(statement, paramIndex);
+        case SQLiteQueryBindTypeInt64:
+            return sqlite3_bind_int64(statement, paramIndex, value->int64Value);
+        case SQLiteQueryBindTypeDouble:
+            return sqlite3_bind_double(statement, paramIndex, value->doubleValue);
+        case SQLiteQueryBindTypeText:
+            return sqlite3_bind_text(statement, paramIndex, (const char *)value->buffer.bytes, value->buffer.length, SQLITE_STATIC);
+        case SQLiteQueryBindTypeBlob:
+            return sqlite3_bind_blob(statement, paramIndex, value->buffer.bytes, value->buffer.length, SQLITE_STATIC);
+        case SQLiteQueryBindTypeInt64Array:
+        case SQLiteQueryBindTypeDoubleArray:
+            // json text whichever way sqlite was built, so the same 'json_each(?)' query works everywhere
+            return SQLiteQueryBindJSONArray(statement, paramIndex, value);
+    }
+    return SQLITE_MISMATCH;
+}
+
+int SQLiteQueryBindObject(sqlite3_stmt *statement, int paramIndex, id value) {
+    if(value == nil || value == [NSNull null]) {
+        return sqlite3_bind_null(statement, paramIndex);
+    }
+    if([value isKindOfClass:[NSNumber class]]) {
+        const char *objCType = [value objCType];
+        if(objCType[0] == 'd' || objCType[0] == 'f') {
+            return sqlite3_bind_double(statement, paramIndex, [value doubleValue]);
+        }
+        // longLongValue would wrap them negative
+        if((objCType[0] == 'Q' || objCType[0] == 'L') && [value unsignedLongLongValue] > (unsigned long long)INT64_MAX) {
+            NSLog(@"[SQLITE] Invalid bind value %@ does not fit in int64", value);
+            return SQLITE_MISMATCH;
+        }
+        return sqlite3_bind_int64(statement, paramIndex, [value longLongValue]);
+    }
+    if([value isKindOfClass:[NSString class]]) {
+        // the UTF8String buffer only lives until the autorelease pool drains, sqlite keeps its own copy
+        return sqlite3_bind_text(statement, paramIndex, [value UTF8String], -1, SQLITE_TRANSIENT);
+    }
+    if([value isKindOfClass:[NSData class]]) {
+        // an NSMutableData can be changed or reallocated while the statement is still bound
+        return sqlite3_bind_blob(statement, paramIndex, [value bytes], (int)[value length], SQLITE_TRANSIENT);
+    }
+    if([value isKindOfClass:[NSArray class]]) {
+        NSData *json = [NSJSONSerialization isValidJSONObject:value] ? [NSJSONSerialization dataWithJSONObject:value options:0 error:nil] : nil;
+        if(json) {
+            return sqlite3_bind_text(statement, paramIndex, [json bytes], (int)[json length], SQLITE_TRANSIENT);
+        }
+    }
+    
+    NSLog(@"[SQLITE] Invalid bind value type %@", [value class]);
+    return SQLITE_MISMATCH;
+}
+
+int SQLiteQueryBindParams(sqlite3_stmt *statement, id params) {
+    if([params isKindOfClass:[NSArray class]]) {
+        int paramIndex = 1;
+        for(id value in (NSArray *)params) {
+            int bindResult = SQLiteQueryBindObject(statement, paramIndex++, value);
+            if(bindResult != SQLITE_OK) {
+                return bindResult;
+            }
+        }
+        return SQLITE_OK;
+    }
+    
+    if([params isKindOfClass:[NSDictionary class]]) {
+        __block int bindResult = SQLITE_OK;
+        
+        [(NSDictionary *)params enumerateKeysAndObjectsUsingBlock:^(NSString *name, id value, BOOL *stop) {
+            int paramIndex = sqlite3_bind_parameter_index(statement, [name UTF8String]);
+            
+            // accept names without their prefix
+            const char *prefixes[] = {":", "@", "$"};
+            for(int i = 0; paramIndex == 0 && i < 3; ++i) {
+                paramIndex = sqlite3_bind_parameter_index(statement, [[NSString stringWithFormat:@"%s%@", prefixes[i], name] UTF8String]);
+            }
+            
+            if(paramIndex == 0) {
+                NSLog(@"[SQLITE] Unknown bind param name %@", name);
+                bindResult = SQLITE_RANGE;
+            }
+            else {
+                bindResult = SQLiteQueryBindObject(statement, paramIndex, value);
+            }
+            *stop = bindResult != SQLITE_OK;
+        }];
+        
+        return bindResult;
+    }
+    
+    if(params != nil) {
+        NSLog(@"[SQLITE] Invalid params object type");
+        return SQLITE_MISUSE;
+    }
+    return SQLITE_OK;
+}
+
+int SQLiteQueryBindTaggedValues(sqlite3_stmt *statement, const SQLiteQueryBindValue *values, int count) {
+    for(int i = 0; i < count; ++i) {
+        int bindResult = SQLiteQueryBindTaggedValue(statement, i + 1, &values[i]);
+        if(bindResult != SQLITE_OK) {
+            return bindResult;
+        }
+    }
+    return SQLITE_OK;
+}
@@ -0,0 +1,139 @@
+//
+// SQLiteQueryBlob.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+@interface SQLiteQueryBlob : NSObject
+
+/**
+ the open blob handle, NULL once closed
+ */
+@property (nonatomic, readonly) sqlite3_blob *blob;
+
+/**
+ size in bytes of the blob, incremental i/o can not change it. insert with zeroblob(n) to reserve space for writes
+ */
+@property (nonatomic, readonly) int length;
+
+/**
+ YES if writes are rejected
+ */
+@property (nonatomic, readonly) BOOL isReadOnly;
+
+/**
+ YES once close was called or reopening failed
+ */
+@property (nonatomic, readonly) BOOL isClosed;
+
+/**
+ Initializes a 'SQLiteQueryBlob' taking ownership of an open blob handle
+ 
+ @param blob handle from sqlite3_blob_open
+ @param readOnly YES if blob was opened without write access
+ @param onClose block called once with blob when this closes, closes the handle and releases its connection
+ 
+ @return newly-initialized SQLiteQueryBlob
+ */
+-(id)initWithBlob:(sqlite3_blob*)blob readOnly:(BOOL)readOnly onClose:(void (^)(sqlite3_blob *blob))onClose;
+
+/**
+ reads length bytes starting at offset
+ 
+ @param buffer destination of at least length bytes
+ @param length byte count
+ @param offset offset into the blob
+ 
+ @return sqlite result of sqlite3_blob_read
+ */
+-(int)readBytes:(void*)buffer length:(int)length atOffset:(int)offset;
+
+/**
+ overwrites length bytes starting at offset
+ 
+ @param bytes source of length bytes
+ @param length byte count, offset + length must not exceed the blob length
+ @param offset offset into the blob
+ 
+ @return sqlite result of sqlite3_blob_write
+ */
+-(int)writeBytes:(const void*)bytes length:(int)length atOffset:(int)offset;
+
+/**
+ points the handle at another row of the same table and column without preparing a new statement
+ 
+ @param rowid rowid of the row to move to
+ 
+ @return sqlite result of sqlite3_blob_reopen, the blob is closed on failure
+ */
+-(int)reopenWithRowid:(sqlite3_int64)rowid;
+
+/**
+ streams the whole blob into stream in chunks, stream is opened if needed and left open
+ 
+ @param stream destination
+ @param chunkSize bytes read per sqlite3_blob_read
+ 
+ @return YES if every byte was written
+ */
+-(BOOL)writeToOutputStream:(NSOutputStream*)stream chunkSize:(NSUInteger)chunkSize;
+
+/**
+ fills the blob from stream in chunks until the stream ends or the blob is full, stream is opened if needed and left open
+ 
+ @param stream source
+ @param chunkSize bytes written per sqlite3_blob_write
+ 
+ @return YES if the stream was read without errors
+ */
+-(BOOL)readFromInputStream:(NSInputStream*)stream chunkSize:(NSUInteger)chunkSize;
+
+/**
+ streams the whole blob into fileDescriptor at its current position
+ 
+ @param fileDescriptor open for writing, caller must close
+ @param chunkSize bytes read per sqlite3_blob_read
+ 
+ @return YES if every byte was written
+ */
+-(BOOL)writeToFileDescriptor:(int)fileDescriptor chunkSize:(NSUInteger)chunkSize;
+
+/**
+ fills the blob from fileDescriptor until end of file or the blob is full
+ 
+ @param fileDescriptor open for reading, caller must close
+ @param chunkSize bytes written per sqlite3_blob_write
+ 
+ @return YES if the file was read without errors
+ */
+-(BOOL)readFromFileDescriptor:(int)fileDescriptor chunkSize:(NSUInteger)chunkSize;
+
+/**
+ closes the handle and releases its connection. safe to call more than once
+ */
+-(void)close;
+
+@end
@@ -0,0 +1,241 @@
+//
+// SQLiteQueryBlob.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryBlob.h"
+#import <unistd.h>
+
+static const NSUInteger SQLiteQueryBlobDefaultChunkSize = 64 * 1024;
+
+@interface SQLiteQueryBlob()
+@property (nonatomic, assign) sqlite3_blob *blob;
+@property (nonatomic, assign) int length;
+@property (nonatomic, assign) BOOL isReadOnly;
+@property (nonatomic, assign) BOOL isClosed;
+@property (nonatomic, copy) void (^onClose)(sqlite3_blob *blob);
+@end
+
+@implementation SQLiteQueryBlob
+
+-(id)initWithBlob:(sqlite3_blob*)blob readOnly:(BOOL)readOnly onClose:(void (^)(sqlite3_blob *blob))onClose {
+    if(self = [super init]) {
+        self.blob = blob;
+        self.isReadOnly = readOnly;
+        self.onClose = onClose;
+        self.length = blob != NULL ? sqlite3_blob_bytes(blob) : 0;
+        self.isClosed = blob == NULL;
+    }
+    return self;
+}
+
+-(void)dealloc {
+    [self close];
+}
+
+-(int)readBytes:(void*)buffer length:(int)length atOffset:(int)offset {
+    if(self.isClosed) {
+        return SQLITE_MISUSE;
+    }
+    return sqlite3_blob_read(self.blob, buffer, length, offset);
+}
+
+-(int)writeBytes:(const void*)bytes length:(int)length atOffset:(int)offset {
+    if(self.isClosed) {
+        return SQLITE_MISUSE;
+    }
+    if(self.isReadOnly) {
+        return SQLITE_READONLY;
+    }
+    return sqlite3_blob_write(self.blob, bytes, length, offset);
+}
+
+-(int)reopenWithRowid:(sqlite3_int64)rowid {
+    if(self.isClosed) {
+        return SQLITE_MISUSE;
+    }
+    
+    int reopenResult = sqlite3_blob_reopen(self.blob, rowid);
+    if(reopenResult != SQLITE_OK) {
+        // the handle is aborted and only good for closing
+        NSLog(@"[SQLITE] Failed to reopen blob at rowid %lld %d %s", rowid, reopenResult, sqlite3_errstr(reopenResult));
+        [self close];
+        return reopenResult;
+    }
+    
+    self.length = sqlite3_blob_bytes(self.blob);
+    return SQLITE_OK;
+}
+
+-(BOOL)writeToOutputStream:(NSOutputStream*)stream chunkSize:(NSUInteger)chunkSize {
+    if(self.isClosed || !stream) {
+        return NO;
+    }
+    if(stream.streamStatus == NSStreamStatusNotOpen) {
+        [stream open];
+    }
+    
+    return [self readChunksOfSize:chunkSize intoBlock:^BOOL(const uint8_t *bytes, int length) {
+        NSInteger written = 0;
+        while(written < length) {
+            NSInteger result = [stream write:bytes + written maxLength:(NSUInteger)(length - written)];
+            if(result <= 0) {
+                NSLog(@"[SQLITE] Failed to write blob to stream %@", stream.streamError);
+                return NO;
+            }
+            written += result;
+        }
+        return YES;
+    }];
+}
+
+-(BOOL)readFromInputStream:(NSInputStream*)stream chunkSize:(NSUInteger)chunkSize {
+    if(self.isClosed || !stream) {
+        return NO;
+    }
+    if(stream.streamStatus == NSStreamStatusNotOpen) {
+        [stream open];
+    }
+    
+    return [self writeChunksOfSize:chunkSize fromBlock:^NSInteger(uint8_t *buffer, int maxLength) {
+        NSInteger result = [stream read:buffer maxLength:(NSUInteger)maxLength];
+        if(result < 0) {
+            NSLog(@"[SQLITE] Failed to read blob from stream %@", stream.streamError);
+        }
+        return result;
+    }];
+}
+
+-(BOOL)writeToFileDescriptor:(int)fileDescriptor chunkSize:(NSUInteger)chunkSize {
+    if(self.isClosed || fileDescriptor < 0) {
+        return NO;
+    }
+    
+    return [self readChunksOfSize:chunkSize intoBlock:^BOOL(const uint8_t *bytes, int length) {
+        ssize_t written = 0;
+        while(written < length) {
+            ssize_t result = write(fileDescriptor, bytes + written, (size_t)(length - written));
+            if(result < 0) {
+                NSLog(@"[SQLITE] Failed to write blob to file %d", errno);
+                return NO;
+            }
+            written += result;
+        }
+        return YES;
+    }];
+}
+
+-(BOOL)readFromFileDescriptor:(int)fileDescriptor chunkSize:(NSUInteger)chunkSize {
+    if(self.isClosed || fileDescriptor < 0) {
+        return NO;
+    }
+    
+    return [self writeChunksOfSize:chunkSize fromBlock:^NSInteger(uint8_t *buffer, int maxLength) {
+        ssize_t result = read(fileDescriptor, buffer, (size_t)maxLength);
+        if(result < 0) {
+            NSLog(@"[SQLITE] Failed to read blob from file %d", errno);
+        }
+        return (NSInteger)result;
+    }];
+}
+
+// reads the blob front to back through one reusable chunk buffer
+-(BOOL)readChunksOfSize:(NSUInteger)chunkSize intoBlock:(BOOL (^)(const uint8_t *bytes, int length))consumeChunk {
+    int bufferSize = (int)MIN(chunkSize > 0 ? chunkSize : SQLiteQueryBlobDefaultChunkSize, (NSUInteger)MAX(self.length, 1));
+    uint8_t *buffer = malloc((size_t)bufferSize);
+    if(buffer == NULL) {
+        return NO;
+    }
+    
+    BOOL succeeded = YES;
+    for(int offset = 0; succeeded && offset < self.length; offset += bufferSize) {
+        int length = MIN(bufferSize, self.length - offset);
+        int readResult = sqlite3_blob_read(self.blob, buffer, length, offset);
+        if(readResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Failed to read blob %d %s", readResult, sqlite3_errstr(readResult));
+            succeeded = NO;
+        }
+        else {
+            succeeded = consumeChunk(buffer, length);
+        }
+    }
+    
+    free(buffer);
+    return succeeded;
+}
+
+// fills the blob front to back until produceChunk returns 0 at end of input or the blob is full
+-(BOOL)writeChunksOfSize:(NSUInteger)chunkSize fromBlock:(NSInteger (^)(uint8_t *buffer, int maxLength))produceChunk {
+    if(self.isReadOnly) {
+        NSLog(@"[SQLITE] Can not write to a read only blob");
+        return NO;
+    }
+    
+    int bufferSize = (int)MIN(chunkSize > 0 ? chunkSize : SQLiteQueryBlobDefaultChunkSize, (NSUInteger)MAX(self.length, 1));
+    uint8_t *buffer = malloc((size_t)bufferSize);
+    if(buffer == NULL) {
+        return NO;
+    }
+    
+    BOOL succeeded = YES;
+    int offset = 0;
+    while(offset < self.length) {
+        NSInteger length = produceChunk(buffer, MIN(bufferSize, self.length - offset));
+        if(length <= 0) {
+            succeeded = length == 0;
+            break;
+        }
+        
+        int writeResult = sqlite3_blob_write(self.blob, buffer, (int)length, offset);
+        if(writeResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Failed to write blob %d %s", writeResult, sqlite3_errstr(writeResult));
+            succeeded = NO;
+            break;
+        }
+        offset += (int)length;
+    }
+    
+    free(buffer);
+    return succeeded;
+}
+
+-(void)close {
+    if(self.isClosed) {
+        return;
+    }
+    self.isClosed = YES;
+    
+    sqlite3_blob *blob = self.blob;
+    self.blob = NULL;
+    
+    if(self.onClose) {
+        self.onClose(blob);
+        self.onClose = nil;
+    }
+    else {
+        sqlite3_blob_close(blob);
+    }
+}
+
+@end
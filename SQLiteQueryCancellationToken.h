@@ -0,0 +1,57 @@
+//
+// SQLiteQueryCancellationToken.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+@interface SQLiteQueryCancellationToken : NSObject
+
+/**
+ YES once cancel was called
+ */
+@property (nonatomic, readonly) BOOL isCancelled;
+
+/**
+ cancels every query using the token. running queries are stopped with sqlite3_interrupt, queued ones are skipped
+ safe to call from any thread and more than once
+ */
+-(void)cancel;
+
+/**
+ registers db as running a query for the token, cancel interrupts it until detachDB: is called
+ 
+ @param db connection about to run a query
+ */
+-(void)attachDB:(sqlite3*)db;
+
+/**
+ unregisters db, call before the connection is checked in or closed
+ 
+ @param db connection passed to attachDB:
+ */
+-(void)detachDB:(sqlite3*)db;
+
+@end
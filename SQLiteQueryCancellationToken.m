@@ -0,0 +1,91 @@
+//
+// SQLiteQueryCancellationToken.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryCancellationToken.h"
+#import <stdatomic.h>
+
+@interface SQLiteQueryCancellationToken()
+@property (nonatomic, assign) CFMutableSetRef attachedDBs;
+@end
+
+@implementation SQLiteQueryCancellationToken {
+    atomic_bool _cancelled;
+}
+
+-(id)init {
+    if(self = [super init]) {
+        atomic_init(&_cancelled, false);
+        self.attachedDBs = CFSetCreateMutable(kCFAllocatorDefault, 0, NULL);
+    }
+    return self;
+}
+
+-(void)dealloc {
+    CFRelease(self.attachedDBs);
+}
+
+-(BOOL)isCancelled {
+    return atomic_load(&_cancelled);
+}
+
+-(void)cancel {
+    atomic_store(&_cancelled, true);
+    
+    // under the lock so no db is interrupted after it was detached and checked in
+    @synchronized(self) {
+        CFIndex count = CFSetGetCount(self.attachedDBs);
+        if(count == 0) {
+            return;
+        }
+        
+        const void **dbs = malloc(sizeof(void *) * (size_t)count);
+        CFSetGetValues(self.attachedDBs, dbs);
+        for(CFIndex i = 0; i < count; ++i) {
+            sqlite3_interrupt((sqlite3 *)dbs[i]);
+        }
+        free(dbs);
+    }
+}
+
+-(void)attachDB:(sqlite3*)db {
+    if(db == NULL) {
+        return;
+    }
+    @synchronized(self) {
+        CFSetAddValue(self.attachedDBs, db);
+    }
+}
+
+-(void)detachDB:(sqlite3*)db {
+    if(db == NULL) {
+        return;
+    }
+    @synchronized(self) {
+        CFSetRemoveValue(self.attachedDBs, db);
+    }
+}
+
+@end
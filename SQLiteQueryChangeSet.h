@@ -0,0 +1,99 @@
+//
+// SQLiteQueryChangeSet.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+typedef NS_ENUM(NSInteger, SQLiteQueryChangeOperation) {
+    SQLiteQueryChangeOperationInsert = SQLITE_INSERT,
+    SQLiteQueryChangeOperationUpdate = SQLITE_UPDATE,
+    SQLiteQueryChangeOperationDelete = SQLITE_DELETE
+};
+
+@interface SQLiteQueryChangeSet : NSObject
+
+/**
+ names of the tables with changes
+ */
+@property (nonatomic, readonly) NSSet *tables;
+
+/**
+ number of changed rows across every table
+ */
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ @param table table name as written by the statement
+ 
+ @return rowid NSNumber -> SQLiteQueryChangeOperation NSNumber, nil if table has no changes
+ */
+-(NSDictionary*)changesForTable:(NSString*)table;
+
+/**
+ calls block once per changed row
+ 
+ @param block called with the net operation on the row. set *stop to YES to stop enumerating
+ */
+-(void)enumerateChangesUsingBlock:(void (^)(NSString *table, SQLiteQueryChangeOperation operation, sqlite3_int64 rowid, BOOL *stop))block;
+
+/**
+ records a row change, coalesced with earlier changes to the same row into one net operation
+ ie an insert then update stays an insert and an insert then delete leaves no change
+ 
+ @param operation the change
+ @param table table name from the sqlite hook
+ @param rowid changed row
+ */
+-(void)recordOperation:(SQLiteQueryChangeOperation)operation onTable:(const char*)table rowid:(sqlite3_int64)rowid;
+
+/**
+ records every change of changeSet after the changes already recorded
+ 
+ @param changeSet later changes
+ */
+-(void)addChangesFromChangeSet:(SQLiteQueryChangeSet*)changeSet;
+
+/**
+ forgets every change and every open savepoint, the transaction rolled back
+ */
+-(void)removeAllChanges;
+
+/**
+ marks the changes recorded so far, call when 'SAVEPOINT' opens. savepoints nest
+ */
+-(void)beginSavepoint;
+
+/**
+ forgets the changes recorded since the innermost beginSavepoint, call on 'ROLLBACK TO'. the savepoint stays open
+ */
+-(void)rollbackToSavepoint;
+
+/**
+ keeps the innermost savepoint's changes as part of the enclosing one, call on 'RELEASE'
+ */
+-(void)releaseSavepoint;
+
+@end
@@ -0,0 +1,199 @@
+//
+// SQLiteQueryChangeSet.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryChangeSet.h"
+
+@interface SQLiteQueryChangeSet()
+@property (nonatomic, strong) NSMutableDictionary *changesByTable;
+@property (nonatomic, assign) char *lastTable;
+@property (nonatomic, strong) NSMutableDictionary *lastTableChanges;
+// changes recorded before each open savepoint, outermost first. changesByTable holds the innermost savepoint's
+@property (nonatomic, strong) NSMutableArray *savepointChanges;
+@end
+
+@implementation SQLiteQueryChangeSet
+
+-(id)init {
+    if(self = [super init]) {
+        self.changesByTable = [[NSMutableDictionary alloc] init];
+        self.savepointChanges = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+-(void)dealloc {
+    free(self.lastTable);
+}
+
+-(NSSet*)tables {
+    return [[self flattenedChangesByTable] keysOfEntriesPassingTest:^BOOL(NSString *table, NSDictionary *changes, BOOL *stop) {
+        return changes.count > 0;
+    }];
+}
+
+-(NSUInteger)count {
+    NSUInteger count = 0;
+    for(NSDictionary *changes in [[self flattenedChangesByTable] allValues]) {
+        count += changes.count;
+    }
+    return count;
+}
+
+// changes of every savepoint level coalesced, the recorded dictionary itself while no savepoint is open
+-(NSDictionary*)flattenedChangesByTable {
+    if(self.savepointChanges.count == 0) {
+        return self.changesByTable;
+    }
+    
+    NSMutableDictionary *flattened = [[NSMutableDictionary alloc] init];
+    for(NSDictionary *levelChanges in [self.savepointChanges arrayByAddingObject:self.changesByTable]) {
+        [self addChangesByTable:levelChanges toChangesByTable:flattened];
+    }
+    return flattened;
+}
+
+-(void)addChangesByTable:(NSDictionary*)changesByTable toChangesByTable:(NSMutableDictionary*)destination {
+    [changesByTable enumerateKeysAndObjectsUsingBlock:^(NSString *table, NSDictionary *changes, BOOL *stop) {
+        NSMutableDictionary *tableChanges = [destination objectForKey:table];
+        if(!tableChanges) {
+            tableChanges = [[NSMutableDictionary alloc] init];
+            [destination setObject:tableChanges forKey:table];
+        }
+        
+        [changes enumerateKeysAndObjectsUsingBlock:^(NSNumber *rowid, NSNumber *operation, BOOL *stopChanges) {
+            [self recordOperation:(SQLiteQueryChangeOperation)[operation integerValue] rowid:[rowid longLongValue] inChanges:tableChanges];
+        }];
+    }];
+}
+
+-(NSDictionary*)changesForTable:(NSString*)table {
+    NSDictionary *changes = [[self flattenedChangesByTable] objectForKey:table];
+    return changes.count > 0 ? [changes copy] : nil;
+}
+
+-(void)enumerateChangesUsingBlock:(void (^)(NSString *table, SQLiteQueryChangeOperation operation, sqlite3_int64 rowid, BOOL *stop))block {
+    __block BOOL stop = NO;
+    
+    [[self flattenedChangesByTable] enumerateKeysAndObjectsUsingBlock:^(NSString *table, NSDictionary *changes, BOOL *stopTables) {
+        [changes enumerateKeysAndObjectsUsingBlock:^(NSNumber *rowid, NSNumber *operation, BOOL *stopChanges) {
+            block(table, (SQLiteQueryChangeOperation)[operation integerValue], [rowid longLongValue], &stop);
+            *stopChanges = stop;
+        }];
+        *stopTables = stop;
+    }];
+}
+
+-(void)recordOperation:(SQLiteQueryChangeOperation)operation onTable:(const char*)table rowid:(sqlite3_int64)rowid {
+    if(table == NULL) {
+        return;
+    }
+    
+    // bulk writes hit the same table row after row, skip the table lookup for each
+    if(self.lastTable == NULL || strcmp(self.lastTable, table) != 0) {
+        NSString *tableName = [NSString stringWithUTF8String:table];
+        NSMutableDictionary *changes = [self.changesByTable objectForKey:tableName];
+        if(!changes) {
+            changes = [[NSMutableDictionary alloc] init];
+            [self.changesByTable setObject:changes forKey:tableName];
+        }
+        
+        free(self.lastTable);
+        self.lastTable = strdup(table);
+        self.lastTableChanges = changes;
+    }
+    
+    [self recordOperation:operation rowid:rowid inChanges:self.lastTableChanges];
+}
+
+-(void)recordOperation:(SQLiteQueryChangeOperation)operation rowid:(sqlite3_int64)rowid inChanges:(NSMutableDictionary*)changes {
+    NSNumber *rowKey = @(rowid);
+    NSNumber *earlierOperation = [changes objectForKey:rowKey];
+    SQLiteQueryChangeOperation netOperation = operation;
+    
+    if(earlierOperation) {
+        SQLiteQueryChangeOperation earlier = (SQLiteQueryChangeOperation)[earlierOperation integerValue];
+        
+        if(earlier == SQLiteQueryChangeOperationInsert && operation == SQLiteQueryChangeOperationDelete) {
+            // never visible outside the transaction
+            [changes removeObjectForKey:rowKey];
+            return;
+        }
+        if(earlier == SQLiteQueryChangeOperationInsert) {
+            netOperation = SQLiteQueryChangeOperationInsert;
+        }
+        else if(earlier == SQLiteQueryChangeOperationDelete && operation == SQLiteQueryChangeOperationInsert) {
+            netOperation = SQLiteQueryChangeOperationUpdate;
+        }
+    }
+    
+    [changes setObject:@(netOperation) forKey:rowKey];
+}
+
+-(void)addChangesFromChangeSet:(SQLiteQueryChangeSet*)changeSet {
+    [self addChangesByTable:[changeSet flattenedChangesByTable] toChangesByTable:self.changesByTable];
+}
+
+-(void)removeAllChanges {
+    [self.changesByTable removeAllObjects];
+    [self.savepointChanges removeAllObjects];
+    [self forgetLastTable];
+}
+
+-(void)beginSavepoint {
+    [self.savepointChanges addObject:self.changesByTable];
+    self.changesByTable = [[NSMutableDictionary alloc] init];
+    [self forgetLastTable];
+}
+
+-(void)rollbackToSavepoint {
+    if(self.savepointChanges.count == 0) {
+        return;
+    }
+    // the savepoint stays open after ROLLBACK TO, only its changes are gone
+    [self.changesByTable removeAllObjects];
+    [self forgetLastTable];
+}
+
+-(void)releaseSavepoint {
+    if(self.savepointChanges.count == 0) {
+        return;
+    }
+    NSMutableDictionary *outerChanges = [self.savepointChanges lastObject];
+    [self.savepointChanges removeLastObject];
+    
+    [self addChangesByTable:self.changesByTable toChangesByTable:outerChanges];
+    self.changesByTable = outerChanges;
+    [self forgetLastTable];
+}
+
+// the fast path of recordOperation:onTable:rowid: points into changesByTable
+-(void)forgetLastTable {
+    free(self.lastTable);
+    self.lastTable = NULL;
+    self.lastTableChanges = nil;
+}
+
+@end
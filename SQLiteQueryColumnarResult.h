@@ -0,0 +1,146 @@
+//
+// SQLiteQueryColumnarResult.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+#import "SQLiteQueryRowLayout.h"
+
+@interface SQLiteQueryColumnarResult : NSObject
+
+/**
+ number of rows appended
+ */
+@property (nonatomic, readonly) NSUInteger rowCount;
+
+/**
+ number of columns
+ */
+@property (nonatomic, readonly) NSUInteger columnCount;
+
+/**
+ Initializes an empty 'SQLiteQueryColumnarResult'
+ 
+ Int32, Int64 and Double columns are stored in contiguous value buffers.
+ TextView and BlobView columns are stored back to back in one byte arena per column with rowCount + 1 offsets
+ 
+ @param columnTypes storage type of each result column
+ @param columnCount number of columnTypes
+ 
+ @return newly-initialized SQLiteQueryColumnarResult
+ */
+-(id)initWithColumnTypes:(const SQLiteQueryColumnType*)columnTypes columnCount:(NSUInteger)columnCount;
+
+/**
+ appends the current row of statement, result columns 0..columnCount-1 are read
+ 
+ @param statement statement positioned on a row
+ */
+-(void)appendRowFromStatement:(sqlite3_stmt*)statement;
+
+/**
+ @param column column index
+ 
+ @return storage type of column
+ */
+-(SQLiteQueryColumnType)typeOfColumn:(NSUInteger)column;
+
+/**
+ @param column an Int32 column
+ 
+ @return rowCount values, 0 for null values. NULL for other column types
+ */
+-(const int32_t*)int32ValuesForColumn:(NSUInteger)column;
+
+/**
+ @param column an Int64 column
+ 
+ @return rowCount values, 0 for null values. NULL for other column types
+ */
+-(const sqlite3_int64*)int64ValuesForColumn:(NSUInteger)column;
+
+/**
+ @param column a Double column
+ 
+ @return rowCount values, 0 for null values. NULL for other column types
+ */
+-(const double*)doubleValuesForColumn:(NSUInteger)column;
+
+/**
+ bytes of every text or blob value of column back to back, text is not nul terminated
+ 
+ @param column a TextView or BlobView column
+ 
+ @return arena bytes, NULL for other column types
+ */
+-(const char*)arenaForColumn:(NSUInteger)column;
+
+/**
+ value of row starts at offsets[row] in the arena and ends at offsets[row + 1]
+ 
+ @param column a TextView or BlobView column
+ 
+ @return rowCount + 1 offsets, NULL for other column types
+ */
+-(const uint64_t*)offsetsForColumn:(NSUInteger)column;
+
+/**
+ bit (row % 8) of byte (row / 8) is set for null values
+ 
+ @param column column index
+ 
+ @return (rowCount + 7) / 8 bytes
+ */
+-(const uint8_t*)nullBitmapForColumn:(NSUInteger)column;
+
+/**
+ @param row row index
+ @param column column index
+ 
+ @return YES if the value is null
+ */
+-(BOOL)isNullAtRow:(NSUInteger)row column:(NSUInteger)column;
+
+/**
+ view into the arena of a TextView column, valid for the lifetime of the result
+ 
+ @param row row index
+ @param column a TextView column
+ 
+ @return text view, text is NULL for null values
+ */
+-(SQLiteQueryTextView)textAtRow:(NSUInteger)row column:(NSUInteger)column;
+
+/**
+ view into the arena of a BlobView column, valid for the lifetime of the result
+ 
+ @param row row index
+ @param column a BlobView column
+ 
+ @return blob view, bytes is NULL for null or empty values
+ */
+-(SQLiteQueryBlobView)blobAtRow:(NSUInteger)row column:(NSUInteger)column;
+
+@end
@@ -0,0 +1,191 @@
+//
+// SQLiteQueryColumnarResult.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryColumnarResult.h"
+
+// storage of one column
+@interface SQLiteQueryColumnarColumn : NSObject
+@property (nonatomic, assign) SQLiteQueryColumnType type;
+@property (nonatomic, strong) NSMutableData *values;
+@property (nonatomic, strong) NSMutableData *offsets;
+@property (nonatomic, strong) NSMutableData *nullBitmap;
+@end
+
+@implementation SQLiteQueryColumnarColumn
+@end
+
+@interface SQLiteQueryColumnarResult()
+@property (nonatomic, assign) NSUInteger rowCount;
+@property (nonatomic, strong) NSArray *columns;
+@end
+
+@implementation SQLiteQueryColumnarResult
+
+-(id)initWithColumnTypes:(const SQLiteQueryColumnType*)columnTypes columnCount:(NSUInteger)columnCount {
+    if(self = [super init]) {
+        NSMutableArray *columns = [[NSMutableArray alloc] initWithCapacity:columnCount];
+        
+        for(NSUInteger i = 0; i < columnCount; ++i) {
+            SQLiteQueryColumnarColumn *column = [[SQLiteQueryColumnarColumn alloc] init];
+            column.type = columnTypes[i];
+            column.values = [[NSMutableData alloc] init];
+            column.nullBitmap = [[NSMutableData alloc] init];
+            
+            if(column.type == SQLiteQueryColumnTypeTextView || column.type == SQLiteQueryColumnTypeBlobView) {
+                uint64_t firstOffset = 0;
+                column.offsets = [[NSMutableData alloc] initWithBytes:&firstOffset length:sizeof(firstOffset)];
+            }
+            [columns addObject:column];
+        }
+        
+        self.columns = columns;
+    }
+    return self;
+}
+
+-(NSUInteger)columnCount {
+    return self.columns.count;
+}
+
+-(void)appendRowFromStatement:(sqlite3_stmt*)statement {
+    NSUInteger row = self.rowCount;
+    int columnIndex = 0;
+    
+    for(SQLiteQueryColumnarColumn *column in self.columns) {
+        BOOL isNull = sqlite3_column_type(statement, columnIndex) == SQLITE_NULL;
+        
+        if(row % 8 == 0) {
+            [column.nullBitmap increaseLengthBy:1];
+        }
+        if(isNull) {
+            ((uint8_t *)[column.nullBitmap mutableBytes])[row / 8] |= (uint8_t)(1 << (row % 8));
+        }
+        
+        switch(column.type) {
+            case SQLiteQueryColumnTypeInt32: {
+                int32_t value = sqlite3_column_int(statement, columnIndex);
+                [column.values appendBytes:&value length:sizeof(value)];
+                break;
+            }
+            case SQLiteQueryColumnTypeInt64: {
+                sqlite3_int64 value = sqlite3_column_int64(statement, columnIndex);
+                [column.values appendBytes:&value length:sizeof(value)];
+                break;
+            }
+            case SQLiteQueryColumnTypeDouble: {
+                double value = sqlite3_column_double(statement, columnIndex);
+                [column.values appendBytes:&value length:sizeof(value)];
+                break;
+            }
+            case SQLiteQueryColumnTypeTextView:
+            case SQLiteQueryColumnTypeBlobView: {
+                const void *bytes = column.type == SQLiteQueryColumnTypeTextView ? (const void *)sqlite3_column_text(statement, columnIndex) : sqlite3_column_blob(statement, columnIndex);
+                int length = sqlite3_column_bytes(statement, columnIndex);
+                if(bytes != NULL && length > 0) {
+                    [column.values appendBytes:bytes length:(NSUInteger)length];
+                }
+                uint64_t endOffset = (uint64_t)[column.values length];
+                [column.offsets appendBytes:&endOffset length:sizeof(endOffset)];
+                break;
+            }
+        }
+        
+        ++columnIndex;
+    }
+    
+    self.rowCount = row + 1;
+}
+
+-(SQLiteQueryColumnType)typeOfColumn:(NSUInteger)column {
+    return ((SQLiteQueryColumnarColumn *)[self.columns objectAtIndex:column]).type;
+}
+
+-(const void*)valuesForColumn:(NSUInteger)column ofType:(SQLiteQueryColumnType)type {
+    SQLiteQueryColumnarColumn *columnStorage = [self.columns objectAtIndex:column];
+    return columnStorage.type == type ? [columnStorage.values bytes] : NULL;
+}
+
+-(const int32_t*)int32ValuesForColumn:(NSUInteger)column {
+    return (const int32_t *)[self valuesForColumn:column ofType:SQLiteQueryColumnTypeInt32];
+}
+
+-(const sqlite3_int64*)int64ValuesForColumn:(NSUInteger)column {
+    return (const sqlite3_int64 *)[self valuesForColumn:column ofType:SQLiteQueryColumnTypeInt64];
+}
+
+-(const double*)doubleValuesForColumn:(NSUInteger)column {
+    return (const double *)[self valuesForColumn:column ofType:SQLiteQueryColumnTypeDouble];
+}
+
+-(const char*)arenaForColumn:(NSUInteger)column {
+    SQLiteQueryColumnarColumn *columnStorage = [self.columns objectAtIndex:column];
+    return columnStorage.offsets ? (const char *)[columnStorage.values bytes] : NULL;
+}
+
+-(const uint64_t*)offsetsForColumn:(NSUInteger)column {
+    SQLiteQueryColumnarColumn *columnStorage = [self.columns objectAtIndex:column];
+    return columnStorage.offsets ? (const uint64_t *)[columnStorage.offsets bytes] : NULL;
+}
+
+-(const uint8_t*)nullBitmapForColumn:(NSUInteger)column {
+    return (const uint8_t *)[((SQLiteQueryColumnarColumn *)[self.columns objectAtIndex:column]).nullBitmap bytes];
+}
+
+-(BOOL)isNullAtRow:(NSUInteger)row column:(NSUInteger)column {
+    const uint8_t *nullBitmap = [self nullBitmapForColumn:column];
+    return row < self.rowCount && (nullBitmap[row / 8] & (1 << (row % 8))) != 0;
+}
+
+-(SQLiteQueryTextView)textAtRow:(NSUInteger)row column:(NSUInteger)column {
+    SQLiteQueryTextView view = { NULL, 0 };
+    
+    if([self typeOfColumn:column] == SQLiteQueryColumnTypeTextView && row < self.rowCount && ![self isNullAtRow:row column:column]) {
+        const uint64_t *offsets = [self offsetsForColumn:column];
+        const char *arena = [self arenaForColumn:column];
+        
+        // an arena holding only empty strings has no bytes
+        view.text = arena != NULL ? arena + offsets[row] : "";
+        view.length = (int)(offsets[row + 1] - offsets[row]);
+    }
+    return view;
+}
+
+-(SQLiteQueryBlobView)blobAtRow:(NSUInteger)row column:(NSUInteger)column {
+    SQLiteQueryBlobView view = { NULL, 0 };
+    const char *arena = [self arenaForColumn:column];
+    
+    if(arena != NULL && [self typeOfColumn:column] == SQLiteQueryColumnTypeBlobView && row < self.rowCount) {
+        const uint64_t *offsets = [self offsetsForColumn:column];
+        int length = (int)(offsets[row + 1] - offsets[row]);
+        if(length > 0) {
+            view.bytes = arena + offsets[row];
+            view.length = length;
+        }
+    }
+    return view;
+}
+
+@end
@@ -0,0 +1,138 @@
+//
+// SQLiteQueryConnection.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// Long-lived sqlite connection held by the SQLiteQueryUtil connection pool
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+@interface SQLiteQueryConnection : NSObject
+
+/**
+ the underlying sqlite connection
+ */
+@property (nonatomic, readonly) sqlite3 *db;
+
+/**
+ YES when the connection was opened with openDBReadOnly:
+ */
+@property (nonatomic, readonly) BOOL isReadOnly;
+
+/**
+ Initializes a 'SQLiteQueryConnection' taking ownership of an open sqlite connection
+ 
+ @param db open sqlite connection
+ @param readOnly connection was opened read only
+ 
+ @return newly-initialized SQLiteQueryConnection
+ */
+-(id)initWithDB:(sqlite3*)db readOnly:(BOOL)readOnly;
+
+/**
+ max number of idle prepared statements kept for reuse, least recently used are finalized first
+ 0 disables the statement cache
+ */
+@property (nonatomic, assign) NSUInteger statementCacheCapacity;
+
+/**
+ hands out an idle cached statement for query or prepares a new one
+ 
+ cached statements come back reset with their bindings cleared
+ the statement belongs to the caller until releaseStatement:forQuery:
+ 
+ @param statement statement reference to assign
+ @param query sqlite query, the cache key
+ @param cacheHit optional, set to YES when the statement came from the cache
+ 
+ @return sqlite result of the prepare
+ */
+-(int)prepareStatement:(sqlite3_stmt**)statement forQuery:(NSString*)query cacheHit:(BOOL*)cacheHit;
+
+/**
+ resets the statement and returns it to the cache, finalizes it if the cache has no room
+ 
+ @param statement statement from prepareStatement:forQuery:cacheHit:
+ @param query the query statement was prepared for
+ 
+ @return sqlite result of the finalize, SQLITE_OK when cached
+ */
+-(int)releaseStatement:(sqlite3_stmt*)statement forQuery:(NSString*)query;
+
+/**
+ finalizes every idle cached statement
+ */
+-(void)clearStatementCache;
+
+/**
+ seconds before the first busy retry, doubled on every further retry up to busyRetryMaxDelay
+ */
+@property (nonatomic, assign) NSTimeInterval busyRetryBaseDelay;
+
+/**
+ upper bound of the delay between two busy retries
+ */
+@property (nonatomic, assign) NSTimeInterval busyRetryMaxDelay;
+
+/**
+ seconds a locked database is retried before SQLITE_BUSY is returned
+ */
+@property (nonatomic, assign) NSTimeInterval busyRetryDeadline;
+
+/**
+ number of times the busy handler waited and retried on this connection
+ */
+@property (nonatomic, readonly) NSUInteger busyRetryCount;
+
+/**
+ generation of the owner's registered sql functions last applied to this connection, 0 for none
+ */
+@property (nonatomic, assign) NSUInteger functionGeneration;
+
+/**
+ installs a sqlite3_busy_handler doing exponential backoff with jitter until busyRetryDeadline
+ replaces any sqlite3_busy_timeout on the connection
+ */
+-(void)installBusyHandler;
+
+/**
+ exponential backoff with jitter, a random delay between half and all of min(baseDelay * 2^attempt, maxDelay)
+ 
+ @param attempt retry number starting at 0
+ @param baseDelay delay of the first retry
+ @param maxDelay upper bound of the delay
+ 
+ @return seconds to wait before the retry
+ */
++(NSTimeInterval)backoffDelayForAttempt:(NSUInteger)attempt baseDelay:(NSTimeInterval)baseDelay maxDelay:(NSTimeInterval)maxDelay;
+
+/**
+ closes the underlying sqlite connection
+ 
+ @return sqlite result
+ */
+-(int)close;
+
+@end
@@ -0,0 +1,180 @@
+//
+// SQLiteQueryConnection.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryConnection.h"
+
+@interface SQLiteQueryConnection()
+@property (nonatomic, assign) sqlite3 *db;
+@property (nonatomic, assign) BOOL isReadOnly;
+
+// idle statements keyed by query, recency ordered least recent first
+@property (nonatomic, strong) NSMutableDictionary *cachedStatements;
+@property (nonatomic, strong) NSMutableArray *cachedStatementQueries;
+
+@property (nonatomic, assign) NSUInteger busyRetryCount;
+@property (nonatomic, assign) CFAbsoluteTime busyStartTime;
+@end
+
+// sqlite3_busy_handler callback, context is the unretained SQLiteQueryConnection owning the db
+static int SQLiteQueryConnectionBusyHandler(void *context, int attempt) {
+    SQLiteQueryConnection *connection = (__bridge SQLiteQueryConnection *)context;
+    
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    if(attempt == 0) {
+        connection.busyStartTime = now;
+    }
+    
+    NSTimeInterval delay = [SQLiteQueryConnection backoffDelayForAttempt:(NSUInteger)attempt baseDelay:connection.busyRetryBaseDelay maxDelay:connection.busyRetryMaxDelay];
+    if(now - connection.busyStartTime + delay > connection.busyRetryDeadline) {
+        // give up, the statement returns SQLITE_BUSY
+        return 0;
+    }
+    
+    connection.busyRetryCount += 1;
+    usleep((useconds_t)(delay * USEC_PER_SEC));
+    return 1;
+}
+
+@implementation SQLiteQueryConnection
+
+-(id)initWithDB:(sqlite3*)db readOnly:(BOOL)readOnly {
+    if(self = [super init]) {
+        self.db = db;
+        self.isReadOnly = readOnly;
+        self.cachedStatements = [[NSMutableDictionary alloc] init];
+        self.cachedStatementQueries = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
++(NSTimeInterval)backoffDelayForAttempt:(NSUInteger)attempt baseDelay:(NSTimeInterval)baseDelay maxDelay:(NSTimeInterval)maxDelay {
+    NSTimeInterval delay = baseDelay * (double)(1ULL << MIN(attempt, (NSUInteger)30));
+    delay = MIN(delay, maxDelay);
+    
+    // jitter so competing writers do not retry in lock step
+    return delay * (0.5 + 0.5 * ((double)arc4random_uniform(1001) / 1000.0));
+}
+
+-(void)installBusyHandler {
+    sqlite3_busy_handler(self.db, SQLiteQueryConnectionBusyHandler, (__bridge void *)self);
+}
+
+-(void)setStatementCacheCapacity:(NSUInteger)statementCacheCapacity {
+    _statementCacheCapacity = statementCacheCapacity;
+    
+    while(self.cachedStatementQueries.count > statementCacheCapacity) {
+        [self evictLeastRecentlyUsedStatement];
+    }
+}
+
+-(int)prepareStatement:(sqlite3_stmt**)statement forQuery:(NSString*)query cacheHit:(BOOL*)cacheHit {
+    NSValue *cachedStatement = [self.cachedStatements objectForKey:query];
+    
+    if(cacheHit) {
+        *cacheHit = cachedStatement != nil;
+    }
+    
+    if(cachedStatement) {
+        // checked out statements leave the cache so nested use of the same query gets its own
+        [self.cachedStatements removeObjectForKey:query];
+        [self.cachedStatementQueries removeObject:query];
+        
+        *statement = [cachedStatement pointerValue];
+        sqlite3_clear_bindings(*statement);
+        return SQLITE_OK;
+    }
+    
+    return sqlite3_prepare_v2(self.db, [query UTF8String], -1, statement, NULL);
+}
+
+-(int)releaseStatement:(sqlite3_stmt*)statement forQuery:(NSString*)query {
+    if(statement == NULL) {
+        return SQLITE_OK;
+    }
+    
+    if(self.statementCacheCapacity == 0 || [self.cachedStatements objectForKey:query] != nil) {
+        return sqlite3_finalize(statement);
+    }
+    
+    // reset now so an idle statement holds no read transaction open
+    sqlite3_reset(statement);
+    
+    NSString *key = [query copy];
+    [self.cachedStatements setObject:[NSValue valueWithPointer:statement] forKey:key];
+    [self.cachedStatementQueries addObject:key];
+    
+    while(self.cachedStatementQueries.count > self.statementCacheCapacity) {
+        [self evictLeastRecentlyUsedStatement];
+    }
+    
+    return SQLITE_OK;
+}
+
+-(void)evictLeastRecentlyUsedStatement {
+    NSString *query = [self.cachedStatementQueries firstObject];
+    if(!query) {
+        return;
+    }
+    
+    sqlite3_stmt *statement = [[self.cachedStatements objectForKey:query] pointerValue];
+    [self.cachedStatements removeObjectForKey:query];
+    [self.cachedStatementQueries removeObjectAtIndex:0];
+    
+    int finalizeResult = sqlite3_finalize(statement);
+    if(finalizeResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to finalize prepare statement %d", finalizeResult);
+    }
+}
+
+-(void)clearStatementCache {
+    while(self.cachedStatementQueries.count > 0) {
+        [self evictLeastRecentlyUsedStatement];
+    }
+}
+
+-(int)close {
+    if(self.db == NULL) {
+        return SQLITE_OK;
+    }
+    
+    // sqlite3_close fails with SQLITE_BUSY while statements are unfinalized
+    [self clearStatementCache];
+    
+    int closeResult = sqlite3_close(self.db);
+    if(closeResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to close db %d %s", closeResult, sqlite3_errmsg(self.db));
+    }
+    else {
+        self.db = NULL;
+    }
+    return closeResult;
+}
+
+-(void)dealloc {
+    [self close];
+}
+
+@end
@@ -0,0 +1,100 @@
+//
+// SQLiteQueryCursor.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// Streams the rows of a single prepared statement
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+#import "SQLiteQueryRowLayout.h"
+
+@interface SQLiteQueryCursor : NSObject
+
+/**
+ the prepared statement, read the current row with sqlite3_column_* after next returns YES
+ NULL once the cursor is closed
+ */
+@property (nonatomic, readonly) sqlite3_stmt *statement;
+
+/**
+ index of the row last returned by next, NSNotFound before the first row
+ */
+@property (nonatomic, readonly) NSUInteger currentRow;
+
+/**
+ result of the last sqlite3_step. SQLITE_DONE when the result set was exhausted
+ */
+@property (nonatomic, readonly) int lastStepResult;
+
+/**
+ YES once close was called or the result set was exhausted
+ */
+@property (nonatomic, readonly) BOOL isClosed;
+
+/**
+ Initializes a 'SQLiteQueryCursor' taking ownership of a prepared statement
+ 
+ @param statement prepared statement with params already bound
+ @param onClose block called once with the statement when the cursor closes, releases the statement and its connection
+ 
+ @return newly-initialized SQLiteQueryCursor
+ */
+-(id)initWithStatement:(sqlite3_stmt*)statement onClose:(void (^)(sqlite3_stmt *statement))onClose;
+
+/**
+ steps to the next row
+ 
+ the cursor closes itself when the result set is exhausted or the step fails
+ 
+ @return YES if a row is available
+ */
+-(BOOL)next;
+
+/**
+ steps to the next row and decodes it into row
+ 
+ text and blob views in row point into the statement and are valid until the next step or close
+ 
+ @param row start of the struct to fill
+ @param layout column to field layout of row
+ 
+ @return YES if a row is available and was decoded
+ */
+-(BOOL)nextIntoRow:(void*)row layout:(SQLiteQueryRowLayout*)layout;
+
+/**
+ calls block for every remaining row until the result set is exhausted or stop is set
+ the cursor is closed when this returns
+ 
+ @param block called for every row. set *stop to YES to stop stepping
+ */
+-(void)enumerateRowsUsingBlock:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow, BOOL *stop))block;
+
+/**
+ stops stepping and releases the statement and its connection. safe to call more than once
+ */
+-(void)close;
+
+@end
@@ -0,0 +1,114 @@
+//
+// SQLiteQueryCursor.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryCursor.h"
+
+@interface SQLiteQueryCursor()
+@property (nonatomic, assign) sqlite3_stmt *statement;
+@property (nonatomic, assign) NSUInteger currentRow;
+@property (nonatomic, assign) int lastStepResult;
+@property (nonatomic, assign) BOOL isClosed;
+@property (nonatomic, copy) void (^onClose)(sqlite3_stmt *statement);
+@end
+
+@implementation SQLiteQueryCursor
+
+-(id)initWithStatement:(sqlite3_stmt*)statement onClose:(void (^)(sqlite3_stmt *statement))onClose {
+    if(self = [super init]) {
+        self.statement = statement;
+        self.onClose = onClose;
+        self.currentRow = NSNotFound;
+        self.lastStepResult = SQLITE_OK;
+        self.isClosed = statement == NULL;
+    }
+    return self;
+}
+
+-(void)dealloc {
+    [self close];
+}
+
+-(BOOL)next {
+    if(self.isClosed) {
+        return NO;
+    }
+    
+    int rowResult = sqlite3_step(self.statement);
+    self.lastStepResult = rowResult;
+    
+    if(rowResult == SQLITE_ROW) {
+        self.currentRow = self.currentRow == NSNotFound ? 0 : self.currentRow + 1;
+        return YES;
+    }
+    
+    if(rowResult != SQLITE_DONE) {
+        NSLog(@"[SQLITE] Error unexpected last row result %d %s", rowResult, sqlite3_errmsg(sqlite3_db_handle(self.statement)));
+    }
+    
+    [self close];
+    return NO;
+}
+
+-(BOOL)nextIntoRow:(void*)row layout:(SQLiteQueryRowLayout*)layout {
+    if(![self next]) {
+        return NO;
+    }
+    
+    SQLiteQueryDecodeRow(layout.bindings, layout.bindingCount, self.statement, row);
+    return YES;
+}
+
+-(void)enumerateRowsUsingBlock:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow, BOOL *stop))block {
+    BOOL stop = NO;
+    
+    while(!stop && [self next]) {
+        if(block) {
+            block(self.statement, self.currentRow, &stop);
+        }
+    }
+    
+    [self close];
+}
+
+-(void)close {
+    if(self.isClosed) {
+        return;
+    }
+    self.isClosed = YES;
+    
+    sqlite3_stmt *statement = self.statement;
+    self.statement = NULL;
+    
+    if(self.onClose) {
+        self.onClose(statement);
+        self.onClose = nil;
+    }
+    else {
+        sqlite3_finalize(statement);
+    }
+}
+
+@end
@@ -0,0 +1,124 @@
+//
+// SQLiteQueryFullTextIndex.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+#import "SQLiteQueryUtil.h"
+
+@interface SQLiteQueryFullTextIndex : NSObject
+
+/**
+ name of the fts5 virtual table
+ */
+@property (nonatomic, readonly, copy) NSString *name;
+
+/**
+ table holding the indexed rows
+ */
+@property (nonatomic, readonly, copy) NSString *contentTable;
+
+/**
+ integer primary key of contentTable
+ */
+@property (nonatomic, readonly, copy) NSString *contentRowidColumn;
+
+/**
+ indexed columns of contentTable
+ */
+@property (nonatomic, readonly, copy) NSArray *columns;
+
+/**
+ optional bm25 weight per column in columns order, nil weighs every column 1
+ */
+@property (nonatomic, copy) NSArray *columnWeights;
+
+/**
+ Initializes a 'SQLiteQueryFullTextIndex', an external content fts5 index over columns of contentTable
+ 
+ @param queryUtil database the index lives in
+ @param name fts5 table name
+ @param contentTable table holding the indexed rows
+ @param contentRowidColumn integer primary key of contentTable
+ @param columns indexed columns of contentTable
+ @param tokenizer fts5 tokenize option, ie @"unicode61 remove_diacritics 2" or @"porter unicode61". nil for the default
+ 
+ @return newly-initialized SQLiteQueryFullTextIndex
+ */
+-(id)initWithQueryUtil:(SQLiteQueryUtil*)queryUtil name:(NSString*)name contentTable:(NSString*)contentTable contentRowidColumn:(NSString*)contentRowidColumn columns:(NSArray*)columns tokenizer:(NSString*)tokenizer;
+
+/**
+ creates the fts5 table and the insert, update and delete triggers on contentTable that keep it in sync
+ 
+ @return YES if the table and triggers exist
+ */
+-(BOOL)create;
+
+/**
+ re-indexes every row of contentTable in chunks, each in its own transaction so writers get in between chunks
+ 
+ the progress is kept in query_util_fts_rebuild and the sync triggers only touch rows already reindexed,
+ rows past the progress are picked up by a later chunk. automerge is off while loading so segments are not
+ merged over and over, the previous setting is restored once loaded. searches see a partial index until the
+ rebuild completes, a failed rebuild leaves the index partial but consistent until it is run again
+ 
+ @param chunkSize rows indexed per transaction, 0 for 10000
+ 
+ @return YES if every chunk committed
+ */
+-(BOOL)rebuildWithChunkSize:(NSUInteger)chunkSize;
+
+/**
+ ranked search returning a cursor over rowid, bm25 score (lower is better) and a snippet of snippetColumn
+ 
+ @param match fts5 match expression
+ @param snippetColumn index into columns the snippet is taken from, -1 for the best matching column
+ @param limit maximum number of rows
+ 
+ @return open cursor or nil if the query could not be prepared
+ */
+-(SQLiteQueryCursor*)cursorForMatch:(NSString*)match snippetColumn:(int)snippetColumn limit:(NSUInteger)limit;
+
+/**
+ asynchronously merges segments on a background queue in small steps so writers are not held up
+ 
+ @param pages fts5 'merge' pages per step, ie 64
+ @param completionQueue queue for onMergeComplete, nil for the main queue
+ @param onMergeComplete optional block called with YES once there is nothing left to merge
+ */
+-(void)mergeInBackgroundWithPages:(int)pages completionQueue:(dispatch_queue_t)completionQueue onMergeComplete:(void (^)(BOOL mergeSucceeded))onMergeComplete;
+
+/**
+ asynchronously merges every segment towards one on a background queue, like the fts5 'optimize' command
+ 
+ runs negative fts5 'merge' steps, which merge segments of every level, each in its own short transaction so writers
+ get in between steps. stops once a step finds nothing left to merge
+ 
+ @param completionQueue queue for onOptimizeComplete, nil for the main queue
+ @param onOptimizeComplete optional block called with YES once optimized
+ */
+-(void)optimizeInBackgroundWithCompletionQueue:(dispatch_queue_t)completionQueue onOptimizeComplete:(void (^)(BOOL optimizeSucceeded))onOptimizeComplete;
+
+@end
@@ -0,0 +1,324 @@
+//
+// SQLiteQueryFullTextIndex.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryFullTextIndex.h"
+
+static const NSUInteger SQLiteQueryFullTextIndexDefaultChunkSize = 10000;
+static const int SQLiteQueryFullTextIndexDefaultAutomerge = 4;
+static const NSTimeInterval SQLiteQueryFullTextIndexStepDelay = 0.005;
+static const int SQLiteQueryFullTextIndexOptimizePages = 64;
+
+static int SQLiteQueryFullTextIndexExec(sqlite3 *db, NSString *sql) {
+    char *errorMessage = NULL;
+    int execResult = sqlite3_exec(db, [sql UTF8String], NULL, NULL, &errorMessage);
+    if(execResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Full text index error %d %s", execResult, errorMessage);
+    }
+    sqlite3_free(errorMessage);
+    return execResult;
+}
+
+@interface SQLiteQueryFullTextIndex()
+@property (nonatomic, strong) SQLiteQueryUtil *queryUtil;
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, copy) NSString *contentTable;
+@property (nonatomic, copy) NSString *contentRowidColumn;
+@property (nonatomic, copy) NSArray *columns;
+@property (nonatomic, copy) NSString *tokenizer;
+@property (nonatomic, strong) dispatch_queue_t maintenanceQueue;
+@end
+
+@implementation SQLiteQueryFullTextIndex
+
+-(id)initWithQueryUtil:(SQLiteQueryUtil*)queryUtil name:(NSString*)name contentTable:(NSString*)contentTable contentRowidColumn:(NSString*)contentRowidColumn columns:(NSArray*)columns tokenizer:(NSString*)tokenizer {
+    if(self = [super init]) {
+        self.queryUtil = queryUtil;
+        self.name = name;
+        self.contentTable = contentTable;
+        self.contentRowidColumn = contentRowidColumn;
+        self.columns = columns;
+        self.tokenizer = tokenizer;
+        self.maintenanceQueue = dispatch_queue_create("SQLiteQueryFullTextIndex.maintenance", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+    }
+    return self;
+}
+
+// quoted columns with prefix, ie new."title", new."body"
+-(NSString*)columnListWithPrefix:(NSString*)prefix {
+    NSMutableArray *columnList = [[NSMutableArray alloc] initWithCapacity:self.columns.count];
+    for(NSString *column in self.columns) {
+        [columnList addObject:[prefix stringByAppendingString:SQLiteQueryUtilQuoteIdentifier(column)]];
+    }
+    return [columnList componentsJoinedByString:@", "];
+}
+
+// a trigger only touches the index for keys at or below the rebuild progress, every key when no rebuild runs
+-(NSString*)indexedCondition:(NSString*)key {
+    return [NSString stringWithFormat:@"%@ <= COALESCE((SELECT last_key FROM query_util_fts_rebuild WHERE name = %@), 9223372036854775807)", key, SQLiteQueryUtilQuoteLiteral(self.name)];
+}
+
+-(BOOL)create {
+    NSString *table = SQLiteQueryUtilQuoteIdentifier(self.name);
+    NSString *contentTable = SQLiteQueryUtilQuoteIdentifier(self.contentTable);
+    NSString *rowid = SQLiteQueryUtilQuoteIdentifier(self.contentRowidColumn);
+    NSString *columns = [self columnListWithPrefix:@""];
+    NSString *newColumns = [self columnListWithPrefix:@"new."];
+    NSString *oldColumns = [self columnListWithPrefix:@"old."];
+    NSString *newRowid = [@"new." stringByAppendingString:rowid];
+    NSString *oldRowid = [@"old." stringByAppendingString:rowid];
+    
+    NSMutableString *options = [NSMutableString stringWithFormat:@"content=%@, content_rowid=%@", SQLiteQueryUtilQuoteLiteral(self.contentTable), SQLiteQueryUtilQuoteLiteral(self.contentRowidColumn)];
+    if(self.tokenizer) {
+        [options appendFormat:@", tokenize=%@", SQLiteQueryUtilQuoteLiteral(self.tokenizer)];
+    }
+    
+    NSString *insertNew = [NSString stringWithFormat:@"INSERT INTO %@(rowid, %@) SELECT %@, %@ WHERE %@;", table, columns, newRowid, newColumns, [self indexedCondition:newRowid]];
+    NSString *deleteOld = [NSString stringWithFormat:@"INSERT INTO %@(%@, rowid, %@) SELECT 'delete', %@, %@ WHERE %@;", table, table, columns, oldRowid, oldColumns, [self indexedCondition:oldRowid]];
+    
+    NSArray *statements = @[
+        @"CREATE TABLE IF NOT EXISTS query_util_fts_rebuild(name TEXT PRIMARY KEY NOT NULL, last_key INTEGER NOT NULL, automerge INTEGER NOT NULL)",
+        [NSString stringWithFormat:@"CREATE VIRTUAL TABLE IF NOT EXISTS %@ USING fts5(%@, %@)", table, columns, options],
+        [NSString stringWithFormat:@"CREATE TRIGGER IF NOT EXISTS %@ AFTER INSERT ON %@ BEGIN %@ END",
+         SQLiteQueryUtilQuoteIdentifier([self.name stringByAppendingString:@"_ai"]), contentTable, insertNew],
+        [NSString stringWithFormat:@"CREATE TRIGGER IF NOT EXISTS %@ AFTER DELETE ON %@ BEGIN %@ END",
+         SQLiteQueryUtilQuoteIdentifier([self.name stringByAppendingString:@"_ad"]), contentTable, deleteOld],
+        [NSString stringWithFormat:@"CREATE TRIGGER IF NOT EXISTS %@ AFTER UPDATE ON %@ BEGIN %@ %@ END",
+         SQLiteQueryUtilQuoteIdentifier([self.name stringByAppendingString:@"_au"]), contentTable, deleteOld, insertNew]
+    ];
+    
+    return [self.queryUtil createTransactionWithOperations:@[^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+        for(NSString *statement in statements) {
+            if(SQLiteQueryFullTextIndexExec(db, statement) != SQLITE_OK) {
+                return NO;
+            }
+        }
+        return YES;
+    }]];
+}
+
+-(NSString*)commandSQL:(NSString*)command rank:(NSNumber*)rank {
+    NSString *table = SQLiteQueryUtilQuoteIdentifier(self.name);
+    return rank ? [NSString stringWithFormat:@"INSERT INTO %@(%@, rank) VALUES(%@, %lld)", table, table, SQLiteQueryUtilQuoteLiteral(command), [rank longLongValue]]
+                : [NSString stringWithFormat:@"INSERT INTO %@(%@) VALUES(%@)", table, table, SQLiteQueryUtilQuoteLiteral(command)];
+}
+
+// the automerge setting lives in the fts5 config shadow table, absent means the fts5 default
+-(int)automergeWithDB:(sqlite3*)db {
+    __block int automerge = SQLiteQueryFullTextIndexDefaultAutomerge;
+    NSString *query = [NSString stringWithFormat:@"SELECT v FROM %@ WHERE k = 'automerge'", SQLiteQueryUtilQuoteIdentifier([self.name stringByAppendingString:@"_config"])];
+    [self.queryUtil queryDB:query withDB:&db withBindParamsCallback:nil onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        automerge = sqlite3_column_int(queryStatement, 0);
+    } onQueryCompleteCallack:nil];
+    return automerge;
+}
+
+-(BOOL)rebuildWithChunkSize:(NSUInteger)chunkSize {
+    NSUInteger rowsPerChunk = chunkSize > 0 ? chunkSize : SQLiteQueryFullTextIndexDefaultChunkSize;
+    
+    NSString *name = self.name;
+    NSString *saveProgress = @"UPDATE query_util_fts_rebuild SET last_key = ? WHERE name = ?";
+    
+    // emptying the index and publishing the progress commit together, from then on the triggers skip every row not reindexed yet
+    __block int previousAutomerge = SQLiteQueryFullTextIndexDefaultAutomerge;
+    NSString *disableAutomerge = [self commandSQL:@"automerge" rank:@(0)];
+    NSString *deleteAll = [self commandSQL:@"delete-all" rank:nil];
+    BOOL rebuildStarted = [self.queryUtil writeTransactionWithOperations:@[^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+        // a rebuild that did not finish already turned automerge off, its row remembers the setting before it
+        __block BOOL interruptedRebuild = NO;
+        [self.queryUtil queryDB:@"SELECT automerge FROM query_util_fts_rebuild WHERE name = ?" withDB:&db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+            sqlite3_bind_text(queryStatement, 1, [name UTF8String], -1, SQLITE_TRANSIENT);
+        } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+            previousAutomerge = sqlite3_column_int(queryStatement, 0);
+            interruptedRebuild = YES;
+        } onQueryCompleteCallack:nil];
+        if(!interruptedRebuild) {
+            previousAutomerge = [self automergeWithDB:db];
+        }
+        
+        // every chunk would otherwise trigger merges of the segments written so far
+        if(SQLiteQueryFullTextIndexExec(db, disableAutomerge) != SQLITE_OK || SQLiteQueryFullTextIndexExec(db, deleteAll) != SQLITE_OK) {
+            return NO;
+        }
+        
+        sqlite3_stmt *statement = [context statementForQuery:@"INSERT OR REPLACE INTO query_util_fts_rebuild(name, last_key, automerge) VALUES(?, ?, ?)"];
+        if(!statement) {
+            return NO;
+        }
+        sqlite3_bind_text(statement, 1, [name UTF8String], -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(statement, 2, INT64_MIN);
+        sqlite3_bind_int(statement, 3, previousAutomerge);
+        return sqlite3_step(statement) == SQLITE_DONE;
+    }]];
+    if(!rebuildStarted) {
+        return NO;
+    }
+    
+    NSString *table = SQLiteQueryUtilQuoteIdentifier(self.name);
+    NSString *rowid = SQLiteQueryUtilQuoteIdentifier(self.contentRowidColumn);
+    NSString *columns = [self columnListWithPrefix:@""];
+    NSString *insertChunk = [NSString stringWithFormat:@"INSERT INTO %@(rowid, %@) SELECT %@, %@ FROM %@ WHERE %@ > ? AND %@ <= ?",
+                             table, columns, rowid, columns, SQLiteQueryUtilQuoteIdentifier(self.contentTable), rowid, rowid];
+    NSString *chunkBounds = [NSString stringWithFormat:@"SELECT max(%@), count(*) FROM (SELECT %@ FROM %@ WHERE %@ > ? ORDER BY %@ LIMIT ?)",
+                             rowid, rowid, SQLiteQueryUtilQuoteIdentifier(self.contentTable), rowid, rowid];
+    
+    BOOL rebuildSucceeded = YES;
+    __block sqlite3_int64 lastKey = INT64_MIN;
+    __block BOOL finished = NO;
+    
+    while(rebuildSucceeded && !finished) {
+        sqlite3_int64 chunkStartKey = lastKey;
+        
+        rebuildSucceeded = [self.queryUtil writeTransactionWithOperations:@[^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            // the highest key in the chunk is where the next chunk starts
+            __block sqlite3_int64 chunkLastKey = chunkStartKey;
+            __block NSUInteger chunkRowCount = 0;
+            [self.queryUtil queryDB:chunkBounds withDB:&db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+                sqlite3_bind_int64(queryStatement, 1, chunkStartKey);
+                sqlite3_bind_int64(queryStatement, 2, (sqlite3_int64)rowsPerChunk);
+            } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+                chunkLastKey = sqlite3_column_int64(queryStatement, 0);
+                chunkRowCount = (NSUInteger)sqlite3_column_int64(queryStatement, 1);
+            } onQueryCompleteCallack:nil];
+            
+            if(chunkRowCount == 0) {
+                finished = YES;
+                return YES;
+            }
+            
+            __block BOOL success = NO;
+            [self.queryUtil writeQueryInDB:insertChunk withDB:&db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+                sqlite3_bind_int64(queryStatement, 1, chunkStartKey);
+                sqlite3_bind_int64(queryStatement, 2, chunkLastKey);
+            } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+                success = YES;
+            } onQueryCompleteCallack:nil];
+            
+            // writes to the chunk's rows are indexed by the triggers once this commits
+            sqlite3_stmt *statement = success ? [context statementForQuery:saveProgress] : NULL;
+            if(statement) {
+                sqlite3_bind_int64(statement, 1, chunkLastKey);
+                sqlite3_bind_text(statement, 2, [name UTF8String], -1, SQLITE_TRANSIENT);
+                success = sqlite3_step(statement) == SQLITE_DONE;
+            }
+            else {
+                success = NO;
+            }
+            
+            if(success) {
+                lastKey = chunkLastKey;
+                finished = chunkRowCount < rowsPerChunk;
+            }
+            return success;
+        }]];
+        
+        if(rebuildSucceeded && !finished) {
+            // let queued writes take the writer before the next chunk
+            [NSThread sleepForTimeInterval:SQLiteQueryFullTextIndexStepDelay];
+        }
+    }
+    
+    if(!rebuildSucceeded) {
+        // the progress row stays so the triggers keep skipping rows that are not indexed, a new rebuild starts over
+        return NO;
+    }
+    
+    NSString *finishRebuild = [NSString stringWithFormat:@"DELETE FROM query_util_fts_rebuild WHERE name = %@", SQLiteQueryUtilQuoteLiteral(name)];
+    NSString *restoreAutomerge = [self commandSQL:@"automerge" rank:@(previousAutomerge)];
+    return [self.queryUtil writeTransactionWithOperations:@[^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+        return SQLiteQueryFullTextIndexExec(db, finishRebuild) == SQLITE_OK && SQLiteQueryFullTextIndexExec(db, restoreAutomerge) == SQLITE_OK;
+    }]];
+}
+
+-(SQLiteQueryCursor*)cursorForMatch:(NSString*)match snippetColumn:(int)snippetColumn limit:(NSUInteger)limit {
+    NSString *table = SQLiteQueryUtilQuoteIdentifier(self.name);
+    
+    NSMutableString *bm25 = [NSMutableString stringWithFormat:@"bm25(%@", table];
+    for(NSNumber *weight in self.columnWeights) {
+        [bm25 appendFormat:@", %g", [weight doubleValue]];
+    }
+    [bm25 appendString:@")"];
+    
+    NSString *query = [NSString stringWithFormat:@"SELECT rowid, %@ AS score, snippet(%@, ?, '[', ']', '...', 16) FROM %@ WHERE %@ MATCH ? ORDER BY score LIMIT ?", bm25, table, table, table];
+    
+    return [self.queryUtil cursorForQuery:query withParams:@[@(snippetColumn), match ?: @"", @(limit)]];
+}
+
+// on the maintenance queue, one 'merge' per short write transaction until fts5 finds nothing left to merge
+-(BOOL)mergeInStepsWithPages:(int)pages {
+    NSString *merge = [self commandSQL:@"merge" rank:@(pages)];
+    
+    BOOL mergeSucceeded = YES;
+    __block BOOL merged = NO;
+    
+    while(mergeSucceeded && !merged) {
+        mergeSucceeded = [self.queryUtil writeTransactionWithOperations:@[^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            // fts5 reports less than 2 changes once there was no work left to do
+            int totalChanges = sqlite3_total_changes(db);
+            BOOL success = SQLiteQueryFullTextIndexExec(db, merge) == SQLITE_OK;
+            merged = sqlite3_total_changes(db) - totalChanges < 2;
+            return success;
+        }]];
+        
+        if(mergeSucceeded && !merged) {
+            [NSThread sleepForTimeInterval:SQLiteQueryFullTextIndexStepDelay];
+        }
+    }
+    
+    return mergeSucceeded;
+}
+
+-(void)mergeInBackgroundWithPages:(int)pages completionQueue:(dispatch_queue_t)completionQueue onMergeComplete:(void (^)(BOOL mergeSucceeded))onMergeComplete {
+    
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    
+    dispatch_async(self.maintenanceQueue, ^{
+        BOOL mergeSucceeded = [self mergeInStepsWithPages:MAX(pages, 1)];
+        
+        if(onMergeComplete) {
+            dispatch_async(callbackQueue, ^{
+                onMergeComplete(mergeSucceeded);
+            });
+        }
+    });
+}
+
+-(void)optimizeInBackgroundWithCompletionQueue:(dispatch_queue_t)completionQueue onOptimizeComplete:(void (^)(BOOL optimizeSucceeded))onOptimizeComplete {
+    
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    
+    dispatch_async(self.maintenanceQueue, ^{
+        // a negative 'merge' merges segments of every level, stepping towards one segment like 'optimize' without holding the writer
+        BOOL optimizeSucceeded = [self mergeInStepsWithPages:-SQLiteQueryFullTextIndexOptimizePages];
+        
+        if(onOptimizeComplete) {
+            dispatch_async(callbackQueue, ^{
+                onOptimizeComplete(optimizeSucceeded);
+            });
+        }
+    });
+}
+
+@end
@@ -0,0 +1,73 @@
+//
+// SQLiteQueryReadSnapshot.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+typedef NS_ENUM(NSInteger, SQLiteQueryConsistentReadMode) {
+    // idle pooled readers opened the shared snapshot and ran reads alongside the session that captured it
+    SQLiteQueryConsistentReadModeParallel,
+    // the reads ran one after another in the session that captured the state, snapshots unsupported, not opened or no reader idle
+    SQLiteQueryConsistentReadModeSerialized,
+    // the read session could not start, no read ran
+    SQLiteQueryConsistentReadModeFailed
+};
+
+/**
+ a WAL read snapshot captured with sqlite3_snapshot_get, other read connections can open the same database state
+ 
+ the snapshot functions are only used when the linked sqlite library was compiled with them, see isSupported. a snapshot can only be opened while the wal still holds it, keep the session that
+ captured it open while sharing it
+ */
+@interface SQLiteQueryReadSnapshot : NSObject
+
+/**
+ the linked sqlite library was compiled with SQLITE_ENABLE_SNAPSHOT
+ 
+ @return snapshots can be captured and opened, the database must also be in WAL mode
+ */
++(BOOL)isSupported;
+
+/**
+ Initializes a 'SQLiteQueryReadSnapshot' of the read transaction open on db
+ 
+ @param db WAL connection inside a read transaction
+ 
+ @return snapshot of db's main database, nil if snapshots are not supported or it can not be captured
+ */
+-(id)initWithDB:(sqlite3*)db;
+
+/**
+ starts the read transaction of db on this snapshot, call right after 'BEGIN' and before anything is read
+ 
+ @param db WAL connection of the same database inside a transaction that has not read yet
+ 
+ @return sqlite result of sqlite3_snapshot_open, SQLITE_ERROR_SNAPSHOT when the snapshot is no longer available.
+ SQLITE_ERROR when snapshots are not supported
+ */
+-(int)openOnDB:(sqlite3*)db;
+
+@end
@@ -0,0 +1,85 @@
+//
+// SQLiteQueryReadSnapshot.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryReadSnapshot.h"
+// sqlite3.h declares the snapshot functions either way, they only work when the library was compiled with them
+static BOOL SQLiteQuerySnapshotFunctionsAvailable() {
+    static BOOL available = NO;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        available = sqlite3_compileoption_used("ENABLE_SNAPSHOT");
+        if(!available) {
+            NSLog(@"[SQLITE] sqlite %s is built without SQLITE_ENABLE_SNAPSHOT, read snapshots are not supported", sqlite3_libversion());
+        }
+    });
+    return available;
+}
+
+@interface SQLiteQueryReadSnapshot()
+@property (nonatomic, assign) sqlite3_snapshot *snapshot;
+@end
+
+@implementation SQLiteQueryReadSnapshot
+
++(BOOL)isSupported {
+    return SQLiteQuerySnapshotFunctionsAvailable();
+}
+
+-(id)initWithDB:(sqlite3*)db {
+    if(!SQLiteQuerySnapshotFunctionsAvailable()) {
+        return nil;
+    }
+    
+    sqlite3_snapshot *snapshot = NULL;
+    int snapshotResult = db ? sqlite3_snapshot_get(db, "main", &snapshot) : SQLITE_MISUSE;
+    if(snapshotResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to get snapshot %d %s", snapshotResult, db ? sqlite3_errmsg(db) : "");
+        return nil;
+    }
+    
+    if(self = [super init]) {
+        self.snapshot = snapshot;
+    }
+    else {
+        sqlite3_snapshot_free(snapshot);
+    }
+    return self;
+}
+
+-(void)dealloc {
+    if(self.snapshot) {
+        sqlite3_snapshot_free(self.snapshot);
+    }
+}
+
+-(int)openOnDB:(sqlite3*)db {
+    if(!SQLiteQuerySnapshotFunctionsAvailable() || !self.snapshot) {
+        return SQLITE_ERROR;
+    }
+    return sqlite3_snapshot_open(db, "main", self.snapshot);
+}
+
+@end
@@ -0,0 +1,117 @@
+//
+// SQLiteQueryResultCache.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// Read-through cache of query results invalidated by table
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+@interface SQLiteQueryResultCache : NSObject
+
+/**
+ approximate bytes of cached rows kept before least recently used results are evicted. 0 disables caching
+ */
+@property (nonatomic, assign) NSUInteger capacity;
+
+/**
+ number of lookups answered from the cache
+ */
+@property (nonatomic, readonly) NSUInteger hitCount;
+
+/**
+ number of lookups that had to run the query
+ */
+@property (nonatomic, readonly) NSUInteger missCount;
+
+/**
+ tables read by query, learned once per query with sqlite3_set_authorizer
+ 
+ @param query sqlite query
+ @param db connection to prepare query on
+ 
+ @return lowercase table names, nil if query could not be prepared
+ */
+-(NSSet*)tablesReadByQuery:(NSString*)query withDB:(sqlite3*)db;
+
+/**
+ cached rows for key
+ 
+ @param key query with its bound values, ie sqlite3_expanded_sql
+ 
+ @return immutable array of immutable row arrays or nil on a miss
+ */
+-(NSArray*)rowsForKey:(NSString*)key;
+
+/**
+ generation of tables, changes whenever any of them is invalidated
+ capture it before running a query and pass it to setRows:forKey:tables:generation:
+ 
+ @param tables lowercase table names
+ 
+ @return current generation
+ */
+-(uint64_t)generationForTables:(NSSet*)tables;
+
+/**
+ caches rows unless one of tables was invalidated since generation was captured
+ 
+ @param rows array of row arrays
+ @param key query with its bound values
+ @param tables lowercase table names the query reads
+ @param generation result of generationForTables: before the query ran
+ */
+-(void)setRows:(NSArray*)rows forKey:(NSString*)key tables:(NSSet*)tables generation:(uint64_t)generation;
+
+/**
+ records a table changed by the writer's open transaction
+ 
+ @param table table name from sqlite3_update_hook
+ */
+-(void)noteChangedTable:(const char*)table;
+
+/**
+ keeps the tables changed by the transaction that just committed for commitPendingInvalidations, called once COMMIT returned SQLITE_OK
+ */
+-(void)commitChangedTables;
+
+/**
+ drops the tables changed by the open transaction, the writer rolled back. earlier committed transactions stay recorded
+ */
+-(void)discardPendingInvalidations;
+
+/**
+ invalidates the tables changed by the transactions committed since the last call
+ */
+-(void)commitPendingInvalidations;
+
+/**
+ invalidates every cached result reading one of tables
+ 
+ @param tables table names, nil invalidates everything
+ */
+-(void)invalidateTables:(NSSet*)tables;
+
+@end
@@ -0,0 +1,306 @@
+//
+// SQLiteQueryResultCache.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryResultCache.h"
+
+// sqlite3_set_authorizer callback collecting the tables a statement reads into an NSMutableSet
+static int SQLiteQueryResultCacheTableAuthorizer(void *context, int action, const char *arg1, const char *arg2, const char *dbName, const char *trigger) {
+    if(action == SQLITE_READ && arg1 != NULL) {
+        NSMutableSet *tables = (__bridge NSMutableSet *)context;
+        [tables addObject:[[NSString stringWithUTF8String:arg1] lowercaseString]];
+    }
+    return SQLITE_OK;
+}
+
+// approximate bytes held by a row of boxed values
+static NSUInteger SQLiteQueryResultCacheRowCost(NSArray *row) {
+    NSUInteger cost = 16;
+    for(id value in row) {
+        if([value isKindOfClass:[NSString class]]) {
+            cost += 16 + [value length] * 2;
+        }
+        else if([value isKindOfClass:[NSData class]]) {
+            cost += 16 + [value length];
+        }
+        else {
+            cost += 16;
+        }
+    }
+    return cost;
+}
+
+@interface SQLiteQueryResultCacheEntry : NSObject
+@property (nonatomic, copy) NSArray *rows;
+@property (nonatomic, copy) NSSet *tables;
+@property (nonatomic, assign) NSUInteger cost;
+@end
+
+@implementation SQLiteQueryResultCacheEntry
+@end
+
+@interface SQLiteQueryResultCache()
+@property (nonatomic, strong) NSMutableDictionary *entries;
+@property (nonatomic, strong) NSMutableOrderedSet *recentKeys; // least recent first
+@property (nonatomic, assign) NSUInteger totalCost;
+@property (nonatomic, assign) NSUInteger hitCount;
+@property (nonatomic, assign) NSUInteger missCount;
+
+@property (nonatomic, strong) NSMutableDictionary *tablesByQuery;
+@property (nonatomic, strong) NSMutableDictionary *generationByTable;
+@property (nonatomic, assign) uint64_t generation;
+
+// touched only on the writer's thread from the update hook
+@property (nonatomic, strong) NSMutableSet *pendingTables;
+// tables of transactions that committed while the writer stays checked out
+@property (nonatomic, strong) NSMutableSet *committedTables;
+@property (nonatomic, assign) char *lastChangedTable;
+@end
+
+@implementation SQLiteQueryResultCache
+
+-(id)init {
+    if(self = [super init]) {
+        self.entries = [[NSMutableDictionary alloc] init];
+        self.recentKeys = [[NSMutableOrderedSet alloc] init];
+        self.tablesByQuery = [[NSMutableDictionary alloc] init];
+        self.generationByTable = [[NSMutableDictionary alloc] init];
+        self.pendingTables = [[NSMutableSet alloc] init];
+        self.committedTables = [[NSMutableSet alloc] init];
+    }
+    return self;
+}
+
+-(void)dealloc {
+    free(self.lastChangedTable);
+}
+
+-(void)setCapacity:(NSUInteger)capacity {
+    @synchronized(self) {
+        _capacity = capacity;
+        [self evictToCapacity];
+    }
+}
+
+// counted under the same lock as the entries, lookups run on every reader queue at once
+-(NSUInteger)hitCount {
+    @synchronized(self) {
+        return _hitCount;
+    }
+}
+
+-(NSUInteger)missCount {
+    @synchronized(self) {
+        return _missCount;
+    }
+}
+
+-(NSSet*)tablesReadByQuery:(NSString*)query withDB:(sqlite3*)db {
+    @synchronized(self) {
+        NSSet *tables = [self.tablesByQuery objectForKey:query];
+        if(tables) {
+            return tables;
+        }
+    }
+    
+    NSMutableSet *tables = [[NSMutableSet alloc] init];
+    
+    // the authorizer only runs during prepare so use a throwaway statement
+    sqlite3_set_authorizer(db, SQLiteQueryResultCacheTableAuthorizer, (__bridge void *)tables);
+    sqlite3_stmt *statement = NULL;
+    int prepareResponse = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+    sqlite3_finalize(statement);
+    sqlite3_set_authorizer(db, NULL, NULL);
+    
+    if(prepareResponse != SQLITE_OK) {
+        return nil;
+    }
+    
+    @synchronized(self) {
+        [self.tablesByQuery setObject:tables forKey:query];
+    }
+    return tables;
+}
+
+-(NSArray*)rowsForKey:(NSString*)key {
+    @synchronized(self) {
+        SQLiteQueryResultCacheEntry *entry = [self.entries objectForKey:key];
+        if(!entry) {
+            ++_missCount;
+            return nil;
+        }
+        
+        ++_hitCount;
+        [self.recentKeys removeObject:key];
+        [self.recentKeys addObject:key];
+        return entry.rows;
+    }
+}
+
+-(uint64_t)generationForTables:(NSSet*)tables {
+    @synchronized(self) {
+        uint64_t generation = 0;
+        for(NSString *table in tables) {
+            generation = MAX(generation, [[self.generationByTable objectForKey:table] unsignedLongLongValue]);
+        }
+        return generation;
+    }
+}
+
+-(void)setRows:(NSArray*)rows forKey:(NSString*)key tables:(NSSet*)tables generation:(uint64_t)generation {
+    if(!(rows && key)) {
+        return;
+    }
+    
+    NSUInteger cost = 0;
+    for(NSArray *row in rows) {
+        cost += SQLiteQueryResultCacheRowCost(row);
+    }
+    
+    @synchronized(self) {
+        // a write landed while the query ran, the rows may already be stale
+        if(self.capacity == 0 || cost > self.capacity || [self generationForTables:tables] != generation) {
+            return;
+        }
+        
+        [self removeEntryForKey:key];
+        
+        // immutable copies of every row so no caller shares a mutable array with the cache
+        SQLiteQueryResultCacheEntry *entry = [[SQLiteQueryResultCacheEntry alloc] init];
+        entry.rows = [[NSArray alloc] initWithArray:rows copyItems:YES];
+        entry.tables = tables;
+        entry.cost = cost;
+        
+        [self.entries setObject:entry forKey:key];
+        [self.recentKeys addObject:key];
+        self.totalCost += cost;
+        
+        [self evictToCapacity];
+    }
+}
+
+-(void)noteChangedTable:(const char*)table {
+    if(table == NULL) {
+        return;
+    }
+    
+    // bulk writes hit the same table row after row, skip building a string for each
+    if(self.lastChangedTable != NULL && strcmp(self.lastChangedTable, table) == 0) {
+        return;
+    }
+    
+    free(self.lastChangedTable);
+    self.lastChangedTable = strdup(table);
+    
+    @synchronized(self) {
+        [self.pendingTables addObject:[[NSString stringWithUTF8String:table] lowercaseString]];
+    }
+}
+
+-(void)commitChangedTables {
+    @synchronized(self) {
+        [self.committedTables unionSet:self.pendingTables];
+        [self.pendingTables removeAllObjects];
+    }
+    free(self.lastChangedTable);
+    self.lastChangedTable = NULL;
+}
+
+-(void)discardPendingInvalidations {
+    @synchronized(self) {
+        [self.pendingTables removeAllObjects];
+    }
+    free(self.lastChangedTable);
+    self.lastChangedTable = NULL;
+}
+
+-(void)commitPendingInvalidations {
+    NSSet *tables = nil;
+    @synchronized(self) {
+        if(self.committedTables.count == 0) {
+            return;
+        }
+        tables = [self.committedTables copy];
+        [self.committedTables removeAllObjects];
+    }
+    
+    [self invalidateTables:tables];
+}
+
+-(void)invalidateTables:(NSSet*)tables {
+    @synchronized(self) {
+        ++self.generation;
+        
+        if(!tables) {
+            // bump every known table so queries already running do not store their result
+            for(NSString *table in [self.generationByTable allKeys]) {
+                [self.generationByTable setObject:@(self.generation) forKey:table];
+            }
+            for(NSSet *queryTables in [self.tablesByQuery allValues]) {
+                for(NSString *table in queryTables) {
+                    [self.generationByTable setObject:@(self.generation) forKey:table];
+                }
+            }
+            [self.entries removeAllObjects];
+            [self.recentKeys removeAllObjects];
+            self.totalCost = 0;
+            return;
+        }
+        
+        NSMutableSet *lowercaseTables = [[NSMutableSet alloc] initWithCapacity:tables.count];
+        for(NSString *table in tables) {
+            NSString *lowercaseTable = [table lowercaseString];
+            [lowercaseTables addObject:lowercaseTable];
+            [self.generationByTable setObject:@(self.generation) forKey:lowercaseTable];
+        }
+        
+        NSMutableArray *staleKeys = [[NSMutableArray alloc] init];
+        [self.entries enumerateKeysAndObjectsUsingBlock:^(NSString *key, SQLiteQueryResultCacheEntry *entry, BOOL *stop) {
+            if([entry.tables intersectsSet:lowercaseTables]) {
+                [staleKeys addObject:key];
+            }
+        }];
+        for(NSString *key in staleKeys) {
+            [self removeEntryForKey:key];
+        }
+    }
+}
+
+-(void)removeEntryForKey:(NSString*)key {
+    SQLiteQueryResultCacheEntry *entry = [self.entries objectForKey:key];
+    if(entry) {
+        self.totalCost -= entry.cost;
+        [self.entries removeObjectForKey:key];
+        [self.recentKeys removeObject:key];
+    }
+}
+
+-(void)evictToCapacity {
+    while(self.totalCost > self.capacity && self.recentKeys.count > 0) {
+        [self removeEntryForKey:[self.recentKeys firstObject]];
+    }
+}
+
+@end
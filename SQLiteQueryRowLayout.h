@@ -0,0 +1,133 @@
+//
+// SQLiteQueryRowLayout.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// Column to struct field layout for decoding rows without boxing
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+typedef NS_ENUM(NSInteger, SQLiteQueryColumnType) {
+    SQLiteQueryColumnTypeInt32,     // int32_t field
+    SQLiteQueryColumnTypeInt64,     // sqlite3_int64 field
+    SQLiteQueryColumnTypeDouble,    // double field
+    SQLiteQueryColumnTypeTextView,  // SQLiteQueryTextView field, valid until the next step
+    SQLiteQueryColumnTypeBlobView   // SQLiteQueryBlobView field, valid until the next step
+};
+
+// zero copy view of a text column, text is NULL for a null value
+typedef struct {
+    const char *text;
+    int length;
+} SQLiteQueryTextView;
+
+// zero copy view of a blob column, bytes is NULL for a null or empty value
+typedef struct {
+    const void *bytes;
+    int length;
+} SQLiteQueryBlobView;
+
+typedef struct {
+    int columnIndex;
+    SQLiteQueryColumnType type;
+    size_t offset;
+} SQLiteQueryColumnBinding;
+
+/**
+ decodes the current row of statement into row using bindings. no objective-c messages are sent
+ 
+ @param bindings column bindings, see -[SQLiteQueryRowLayout bindings]
+ @param bindingCount number of bindings
+ @param statement statement positioned on a row
+ @param row start of the struct to fill
+ */
+static inline void SQLiteQueryDecodeRow(const SQLiteQueryColumnBinding *bindings, NSUInteger bindingCount, sqlite3_stmt *statement, void *row) {
+    char *rowBytes = (char *)row;
+    
+    for(NSUInteger i = 0; i < bindingCount; ++i) {
+        const SQLiteQueryColumnBinding *binding = &bindings[i];
+        void *field = rowBytes + binding->offset;
+        
+        switch(binding->type) {
+            case SQLiteQueryColumnTypeInt32:
+                *(int32_t *)field = sqlite3_column_int(statement, binding->columnIndex);
+                break;
+            case SQLiteQueryColumnTypeInt64:
+                *(sqlite3_int64 *)field = sqlite3_column_int64(statement, binding->columnIndex);
+                break;
+            case SQLiteQueryColumnTypeDouble:
+                *(double *)field = sqlite3_column_double(statement, binding->columnIndex);
+                break;
+            case SQLiteQueryColumnTypeTextView: {
+                SQLiteQueryTextView *view = (SQLiteQueryTextView *)field;
+                view->text = (const char *)sqlite3_column_text(statement, binding->columnIndex);
+                view->length = sqlite3_column_bytes(statement, binding->columnIndex);
+                break;
+            }
+            case SQLiteQueryColumnTypeBlobView: {
+                SQLiteQueryBlobView *view = (SQLiteQueryBlobView *)field;
+                view->bytes = sqlite3_column_blob(statement, binding->columnIndex);
+                view->length = sqlite3_column_bytes(statement, binding->columnIndex);
+                break;
+            }
+        }
+    }
+}
+
+@interface SQLiteQueryRowLayout : NSObject
+
+/**
+ contiguous array of the column bindings added so far
+ */
+@property (nonatomic, readonly) const SQLiteQueryColumnBinding *bindings;
+
+/**
+ number of column bindings
+ */
+@property (nonatomic, readonly) NSUInteger bindingCount;
+
+/**
+ YES if any column decodes to a text or blob view. views are only valid until the next step
+ */
+@property (nonatomic, readonly) BOOL hasViewColumns;
+
+/**
+ maps a result column to a field of the row struct
+ 
+ @param columnIndex result column, starts at 0
+ @param type decoded type of the field
+ @param offset offset of the field in the row struct, ie offsetof(Foo, name)
+ */
+-(void)addColumn:(int)columnIndex type:(SQLiteQueryColumnType)type offset:(size_t)offset;
+
+/**
+ decodes the current row of statement into row
+ 
+ @param statement statement positioned on a row
+ @param row start of the struct to fill
+ */
+-(void)decodeRowFromStatement:(sqlite3_stmt*)statement intoRow:(void*)row;
+
+@end
@@ -0,0 +1,64 @@
+//
+// SQLiteQueryRowLayout.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryRowLayout.h"
+
+@interface SQLiteQueryRowLayout()
+@property (nonatomic, strong) NSMutableData *bindingStorage;
+@property (nonatomic, assign) BOOL hasViewColumns;
+@end
+
+@implementation SQLiteQueryRowLayout
+
+-(id)init {
+    if(self = [super init]) {
+        self.bindingStorage = [[NSMutableData alloc] init];
+    }
+    return self;
+}
+
+-(const SQLiteQueryColumnBinding *)bindings {
+    return (const SQLiteQueryColumnBinding *)[self.bindingStorage bytes];
+}
+
+-(NSUInteger)bindingCount {
+    return [self.bindingStorage length] / sizeof(SQLiteQueryColumnBinding);
+}
+
+-(void)addColumn:(int)columnIndex type:(SQLiteQueryColumnType)type offset:(size_t)offset {
+    SQLiteQueryColumnBinding binding = { columnIndex, type, offset };
+    [self.bindingStorage appendBytes:&binding length:sizeof(binding)];
+    
+    if(type == SQLiteQueryColumnTypeTextView || type == SQLiteQueryColumnTypeBlobView) {
+        self.hasViewColumns = YES;
+    }
+}
+
+-(void)decodeRowFromStatement:(sqlite3_stmt*)statement intoRow:(void*)row {
+    SQLiteQueryDecodeRow(self.bindings, self.bindingCount, statement, row);
+}
+
+@end
@@ -0,0 +1,132 @@
+//
+// SQLiteQueryShardSet.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+#import "SQLiteQueryUtil.h"
+
+/**
+ picks the shard a key lives in
+ 
+ @param key routing key, ie an account id
+ @param shardCount number of shards
+ 
+ @return shard index below shardCount
+ */
+typedef NSUInteger(^SQLiteQueryShardRouter)(id key, NSUInteger shardCount);
+
+/**
+ default routing, stable across launches and os versions since it decides which file a row is stored in
+ 
+ integer NSNumber keys route by integer value, NSString and NSData keys by an FNV-1a hash of their bytes.
+ floating point NSNumbers are rejected so 1.2 and 1.7 do not land with 1, other types are rejected since -hash is not stable
+ 
+ @param key routing key
+ @param shardCount number of shards
+ 
+ @return shard index below shardCount, NSNotFound for a rejected key
+ */
+NSUInteger SQLiteQueryShardDefaultRoute(id key, NSUInteger shardCount);
+
+@interface SQLiteQueryShardSet : NSObject
+
+/**
+ one SQLiteQueryUtil per shard file in dbPaths order, each with its own reader pool and writer queue
+ */
+@property (nonatomic, readonly, copy) NSArray *shards;
+
+/**
+ routing function, nil uses SQLiteQueryShardDefaultRoute. must not change once rows were written
+ */
+@property (nonatomic, copy) SQLiteQueryShardRouter router;
+
+/**
+ Initializes a 'SQLiteQueryShardSet' over a set of database files sharing one schema
+ 
+ @param dbPaths database path of every shard on disk including filename and extension
+ @param configuration optional PRAGMA profile applied to every shard
+ 
+ @return newly-initialized SQLiteQueryShardSet
+ */
+-(id)initWithDBPaths:(NSArray*)dbPaths configuration:(SQLiteQueryUtilConfiguration*)configuration;
+
+/**
+ @param key routing key
+ 
+ @return the shard key routes to
+ */
+-(SQLiteQueryUtil*)shardForKey:(id)key;
+
+/**
+ executes write operations in one transaction on the shard key routes to
+ 
+ shards have independent writers so transactions on different shards commit in parallel.
+ a transaction never spans shards
+ 
+ @param key routing key
+ @param operationsInTransaction an array of SQLiteQueryUtilTransactionOperation's
+ 
+ @return successfully committed all operationsInTransaction
+ */
+-(BOOL)writeTransactionForKey:(id)key operations:(NSArray*)operationsInTransaction;
+
+/**
+ enqueues write operations on the group commit writer queue of the shard key routes to
+ 
+ @see -[SQLiteQueryUtil enqueueWriteTransactionWithOperations:completionQueue:onTransactionComplete:]
+ */
+-(void)enqueueWriteTransactionForKey:(id)key operations:(NSArray*)operationsInTransaction completionQueue:(dispatch_queue_t)completionQueue onTransactionComplete:(void (^)(BOOL transactionSucceeded))onTransactionComplete;
+
+/**
+ runs query on every shard in parallel, each on a pooled read only connection of its shard, and merges the rows
+ 
+ shards are read independently, rows committed on one shard during the fan out may be missing from another
+ 
+ @param query sqlite query run unchanged on every shard
+ @param params NSArray for '?' params or NSDictionary for named params, nil for none
+ @param rowMapper block turning the current row into an object, nil skips the row
+ @param comparator optional ordering of the merged rows, nil keeps shard order
+ @param completionQueue queue for onQueryComplete, nil for the main queue
+ @param onQueryComplete block called once with the merged rows. querySucceeded is NO when params failed to bind or the
+ query failed on any shard, the rows of those shards are left out
+ */
+-(void)queryAllShards:(NSString*)query withParams:(id)params rowMapper:(id (^)(sqlite3_stmt *queryStatement, NSUInteger shardIndex))rowMapper sortedUsingComparator:(NSComparator)comparator completionQueue:(dispatch_queue_t)completionQueue onQueryComplete:(void (^)(NSArray *rows, BOOL querySucceeded))onQueryComplete;
+
+/**
+ runs one query over every shard on a single read only connection with the other shards ATTACHed
+ 
+ the first shard is 'main', shard n is attached as 'shard_n' so tables are addressed as shard_1.table.
+ the number of shards is bounded by SQLITE_LIMIT_ATTACHED, 10 by default
+ 
+ @param query sqlite query, ie 'SELECT id FROM main.t UNION ALL SELECT id FROM shard_1.t'
+ @param params NSArray for '?' params or NSDictionary for named params, nil for none
+ @param onNextRowCallback optional block called for every row in query resultset
+ 
+ @return shards attached, params bound and the query ran to completion
+ */
+-(BOOL)queryAttachedShards:(NSString*)query withParams:(id)params onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback;
+
+@end
@@ -0,0 +1,265 @@
+//
+// SQLiteQueryShardSet.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryShardSet.h"
+
+static const uint64_t SQLiteQueryShardFNVOffsetBasis = 14695981039346656037ULL;
+static const uint64_t SQLiteQueryShardFNVPrime = 1099511628211ULL;
+
+static uint64_t SQLiteQueryShardHashBytes(const void *bytes, NSUInteger length) {
+    uint64_t hash = SQLiteQueryShardFNVOffsetBasis;
+    const uint8_t *byte = bytes;
+    for(NSUInteger index = 0; index < length; ++index) {
+        hash ^= byte[index];
+        hash *= SQLiteQueryShardFNVPrime;
+    }
+    return hash;
+}
+
+NSUInteger SQLiteQueryShardDefaultRoute(id key, NSUInteger shardCount) {
+    if(shardCount == 0) {
+        return 0;
+    }
+    
+    // -hash is not guaranteed stable between os versions, only hash what is persisted
+    uint64_t hash = 0;
+    if([key isKindOfClass:[NSNumber class]]) {
+        // 1.2 and 1.7 must not share 1's shard through longLongValue
+        const char *objCType = [key objCType];
+        if(objCType[0] == 'd' || objCType[0] == 'f') {
+            NSLog(@"[SQLITE] Invalid shard key %@, only integer numbers route", key);
+            return NSNotFound;
+        }
+        hash = objCType[0] == 'Q' || objCType[0] == 'L' ? [key unsignedLongLongValue] : (uint64_t)[key longLongValue];
+    }
+    else if([key isKindOfClass:[NSString class]]) {
+        const char *utf8 = [key UTF8String];
+        hash = SQLiteQueryShardHashBytes(utf8, strlen(utf8));
+    }
+    else if([key isKindOfClass:[NSData class]]) {
+        hash = SQLiteQueryShardHashBytes([key bytes], [key length]);
+    }
+    else {
+        NSLog(@"[SQLITE] Invalid shard key type %@", [key class]);
+        return NSNotFound;
+    }
+    return (NSUInteger)(hash % shardCount);
+}
+
+@interface SQLiteQueryShardSet()
+@property (nonatomic, copy) NSArray *shards;
+@end
+
+@implementation SQLiteQueryShardSet
+
+// binds params and steps query on db, nothing is reported as rows unless every param bound and the query reached SQLITE_DONE
++(BOOL)runQuery:(NSString*)query onShard:(SQLiteQueryUtil*)shard withDB:(sqlite3**)db params:(id)params onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback {
+    __block int bindResult = SQLITE_OK;
+    SQLiteQueryCursor *cursor = [shard cursorForQuery:query withDB:db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        bindResult = SQLiteQueryBindParams(queryStatement, params);
+    }];
+    if(!cursor) {
+        return NO;
+    }
+    
+    // a failed bind leaves NULLs, the rows would be wrong
+    if(bindResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to bind shard query params %d", bindResult);
+        [cursor close];
+        return NO;
+    }
+    
+    [cursor enumerateRowsUsingBlock:^(sqlite3_stmt *queryStatement, NSUInteger currentRow, BOOL *stop) {
+        if(onNextRowCallback) {
+            onNextRowCallback(queryStatement, currentRow);
+        }
+    }];
+    
+    if(cursor.lastStepResult != SQLITE_DONE) {
+        NSLog(@"[SQLITE] Error shard query failed %d %s", cursor.lastStepResult, sqlite3_errmsg(*db));
+        return NO;
+    }
+    return YES;
+}
+
+-(id)initWithDBPaths:(NSArray*)dbPaths configuration:(SQLiteQueryUtilConfiguration*)configuration {
+    if(self = [super init]) {
+        NSMutableArray *shards = [[NSMutableArray alloc] initWithCapacity:dbPaths.count];
+        for(NSString *dbPath in dbPaths) {
+            [shards addObject:[[SQLiteQueryUtil alloc] initWithDBPath:dbPath configuration:configuration]];
+        }
+        self.shards = shards;
+    }
+    return self;
+}
+
+-(SQLiteQueryUtil*)shardForKey:(id)key {
+    NSUInteger shardCount = self.shards.count;
+    if(shardCount == 0) {
+        NSLog(@"[SQLITE] Invalid shard usage, no shards");
+        return nil;
+    }
+    
+    SQLiteQueryShardRouter router = self.router;
+    NSUInteger shardIndex = router ? router(key, shardCount) : SQLiteQueryShardDefaultRoute(key, shardCount);
+    if(shardIndex >= shardCount) {
+        NSLog(@"[SQLITE] Invalid shard %lu of %lu", (unsigned long)shardIndex, (unsigned long)shardCount);
+        return nil;
+    }
+    return self.shards[shardIndex];
+}
+
+-(BOOL)writeTransactionForKey:(id)key operations:(NSArray*)operationsInTransaction {
+    return [[self shardForKey:key] writeTransactionWithOperations:operationsInTransaction];
+}
+
+-(void)enqueueWriteTransactionForKey:(id)key operations:(NSArray*)operationsInTransaction completionQueue:(dispatch_queue_t)completionQueue onTransactionComplete:(void (^)(BOOL transactionSucceeded))onTransactionComplete {
+    
+    SQLiteQueryUtil *shard = [self shardForKey:key];
+    if(!shard) {
+        dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+        dispatch_async(callbackQueue, ^{
+            if(onTransactionComplete) {
+                onTransactionComplete(NO);
+            }
+        });
+        return;
+    }
+    
+    [shard enqueueWriteTransactionWithOperations:operationsInTransaction completionQueue:completionQueue onTransactionComplete:onTransactionComplete];
+}
+
+-(void)queryAllShards:(NSString*)query withParams:(id)params rowMapper:(id (^)(sqlite3_stmt *queryStatement, NSUInteger shardIndex))rowMapper sortedUsingComparator:(NSComparator)comparator completionQueue:(dispatch_queue_t)completionQueue onQueryComplete:(void (^)(NSArray *rows, BOOL querySucceeded))onQueryComplete {
+    
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    dispatch_group_t shardGroup = dispatch_group_create();
+    
+    NSUInteger shardCount = self.shards.count;
+    NSMutableArray *rowsByShard = [[NSMutableArray alloc] initWithCapacity:shardCount];
+    for(NSUInteger i = 0; i < shardCount; ++i) {
+        [rowsByShard addObject:@[]];
+    }
+    
+    __block BOOL querySucceeded = YES;
+    
+    // collects every shard's rows off the main queue before merging
+    dispatch_queue_t collectQueue = dispatch_queue_create("SQLiteQueryShardSet.collect", DISPATCH_QUEUE_SERIAL);
+    
+    [self.shards enumerateObjectsUsingBlock:^(SQLiteQueryUtil *shard, NSUInteger shardIndex, BOOL *stop) {
+        
+        dispatch_group_enter(shardGroup);
+        [shard performReadOperationsInParallel:@[^id(sqlite3 *db) {
+            
+            NSMutableArray *shardRows = [[NSMutableArray alloc] init];
+            BOOL shardSucceeded = [SQLiteQueryShardSet runQuery:query onShard:shard withDB:&db params:params onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+                id row = rowMapper ? rowMapper(queryStatement, shardIndex) : nil;
+                if(row) {
+                    [shardRows addObject:row];
+                }
+            }];
+            // nil fails the shard, no partial rows
+            return shardSucceeded ? shardRows : nil;
+            
+        }] completionQueue:collectQueue onReadsComplete:^(NSArray *results) {
+            
+            id shardRows = [results firstObject];
+            if([shardRows isKindOfClass:[NSArray class]]) {
+                [rowsByShard replaceObjectAtIndex:shardIndex withObject:shardRows];
+            }
+            else {
+                querySucceeded = NO;
+            }
+            dispatch_group_leave(shardGroup);
+        }];
+    }];
+    
+    dispatch_group_notify(shardGroup, collectQueue, ^{
+        
+        NSMutableArray *rows = [[NSMutableArray alloc] init];
+        for(NSArray *shardRows in rowsByShard) {
+            [rows addObjectsFromArray:shardRows];
+        }
+        
+        // stable so rows comparing equal keep shard order
+        NSArray *mergedRows = comparator ? [rows sortedArrayWithOptions:NSSortStable usingComparator:comparator] : [rows copy];
+        
+        dispatch_async(callbackQueue, ^{
+            if(onQueryComplete) {
+                onQueryComplete(mergedRows, querySucceeded);
+            }
+        });
+    });
+}
+
+-(BOOL)queryAttachedShards:(NSString*)query withParams:(id)params onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback {
+    
+    SQLiteQueryUtil *mainShard = [self.shards firstObject];
+    if(!([query isKindOfClass:[NSString class]] && mainShard)) {
+        NSLog(@"[SQLITE] Invalid query usage");
+        return NO;
+    }
+    
+    // a connection of its own, a pooled reader would keep the attachments
+    sqlite3 *db = NULL;
+    int dbOpenResult = [mainShard openDBReadOnly:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NO;
+    }
+    
+    NSUInteger attachLimit = (NSUInteger)sqlite3_limit(db, SQLITE_LIMIT_ATTACHED, -1);
+    BOOL attached = self.shards.count - 1 <= attachLimit;
+    if(!attached) {
+        NSLog(@"[SQLITE] Error %lu shards exceed the attach limit %lu", (unsigned long)self.shards.count, (unsigned long)attachLimit);
+    }
+    
+    for(NSUInteger shardIndex = 1; attached && shardIndex < self.shards.count; ++shardIndex) {
+        SQLiteQueryUtil *shard = self.shards[shardIndex];
+        
+        __block BOOL shardAttached = NO;
+        NSString *attachQuery = [NSString stringWithFormat:@"ATTACH DATABASE ? AS shard_%lu", (unsigned long)shardIndex];
+        [mainShard writeQueryInDB:attachQuery withDB:&db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+            sqlite3_bind_text(queryStatement, 1, [shard.dbPath UTF8String], -1, SQLITE_TRANSIENT);
+        } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+            shardAttached = YES;
+        } onQueryCompleteCallack:nil];
+        
+        attached &= shardAttached;
+    }
+    
+    BOOL querySucceeded = attached && [SQLiteQueryShardSet runQuery:query onShard:mainShard withDB:&db params:params onNextRowCallback:onNextRowCallback];
+    
+    // closing drops the attachments
+    int closeResult = sqlite3_close(db);
+    if(closeResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to close db %d", closeResult);
+    }
+    
+    return querySucceeded;
+}
+
+@end
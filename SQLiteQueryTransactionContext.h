@@ -0,0 +1,123 @@
+//
+// SQLiteQueryTransactionContext.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+#import "SQLiteQueryChangeSet.h"
+
+@class SQLiteQueryConnection;
+
+/**
+ number of int64 registers of a SQLiteQueryTransactionContext
+ */
+static const NSUInteger SQLiteQueryTransactionContextRegisterCount = 16;
+
+/**
+ state shared by the operations of one transaction, ie an insert rowid used as a foreign key by a later operation
+ 
+ int64 registers and statements that stay prepared until the transaction ends avoid boxing values into a dictionary.
+ it is still an NSMutableDictionary for operations using keyed values, its storage is allocated on first use
+ */
+@interface SQLiteQueryTransactionContext : NSMutableDictionary
+
+/**
+ connection the transaction runs on
+ */
+@property (nonatomic, readonly) sqlite3 *db;
+
+/**
+ number of savepoints currently open, 0 outside savepointWithOperations:
+ */
+@property (nonatomic, readonly) NSUInteger savepointDepth;
+
+/**
+ uncommitted changes recorded by the writer's hooks, marked on every savepoint so a 'ROLLBACK TO' drops its changes. nil when not recording
+ */
+@property (nonatomic, strong) SQLiteQueryChangeSet *changeSet;
+
+/**
+ Initializes a 'SQLiteQueryTransactionContext'
+ 
+ @param db connection the transaction runs on
+ @param connection pooled connection of db whose statement cache is used, nil prepares and finalizes directly
+ 
+ @return newly-initialized SQLiteQueryTransactionContext
+ */
+-(id)initWithDB:(sqlite3*)db connection:(SQLiteQueryConnection*)connection;
+
+/**
+ @param value value to store
+ @param index register below SQLiteQueryTransactionContextRegisterCount
+ */
+-(void)setInt64:(sqlite3_int64)value forRegister:(NSUInteger)index;
+
+/**
+ @param index register below SQLiteQueryTransactionContextRegisterCount
+ 
+ @return value stored in the register, 0 if never set
+ */
+-(sqlite3_int64)int64ForRegister:(NSUInteger)index;
+
+/**
+ stores sqlite3_last_insert_rowid of the transaction's connection
+ 
+ @param index register below SQLiteQueryTransactionContextRegisterCount
+ 
+ @return the stored rowid
+ */
+-(sqlite3_int64)storeLastInsertRowidInRegister:(NSUInteger)index;
+
+/**
+ statement for query that stays prepared until the transaction ends, operations running the same query share it
+ 
+ comes back reset with its bindings cleared, the caller binds and steps it but must not finalize it
+ 
+ @param query sqlite query
+ 
+ @return prepared statement, NULL if the prepare failed
+ */
+-(sqlite3_stmt*)statementForQuery:(NSString*)query;
+
+/**
+ runs operations inside 'SAVEPOINT', nested calls nest savepoints
+ 
+ if an operation fails the work since the savepoint is rolled back with 'ROLLBACK TO' and the registers are restored,
+ the enclosing transaction continues and decides for itself whether it fails
+ 
+ @param operations an array of SQLiteQueryUtilTransactionOperation's, called with this context
+ 
+ @return every operation succeeded and the savepoint was released
+ */
+-(BOOL)savepointWithOperations:(NSArray*)operations;
+
+/**
+ returns every statement from statementForQuery: to the statement cache, called when the transaction ends
+ */
+-(void)releaseStatements;
+
+@end
+
+typedef BOOL(^SQLiteQueryUtilTransactionOperation)(sqlite3 *, SQLiteQueryTransactionContext *);
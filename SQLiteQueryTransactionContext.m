@@ -0,0 +1,216 @@
+//
+// SQLiteQueryTransactionContext.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryTransactionContext.h"
+#import "SQLiteQueryConnection.h"
+
+@interface SQLiteQueryTransactionContext() {
+    sqlite3_int64 _registers[SQLiteQueryTransactionContextRegisterCount];
+}
+@property (nonatomic, assign) sqlite3 *db;
+@property (nonatomic, assign) NSUInteger savepointDepth;
+@property (nonatomic, strong) SQLiteQueryConnection *connection;
+@property (nonatomic, strong) NSMutableDictionary *values;
+@property (nonatomic, assign) CFMutableDictionaryRef statementsByQuery;
+@end
+
+@implementation SQLiteQueryTransactionContext
+
+-(id)init {
+    return [self initWithDB:NULL connection:nil];
+}
+
+-(id)initWithCapacity:(NSUInteger)numItems {
+    return [self initWithDB:NULL connection:nil];
+}
+
+-(id)initWithDB:(sqlite3*)db connection:(SQLiteQueryConnection*)connection {
+    if(self = [super init]) {
+        self.db = db;
+        self.connection = connection;
+    }
+    return self;
+}
+
+-(void)dealloc {
+    [self releaseStatements];
+}
+
+#pragma mark - registers
+
+-(void)setInt64:(sqlite3_int64)value forRegister:(NSUInteger)index {
+    if(index >= SQLiteQueryTransactionContextRegisterCount) {
+        NSLog(@"[SQLITE] Invalid register %lu", (unsigned long)index);
+        return;
+    }
+    _registers[index] = value;
+}
+
+-(sqlite3_int64)int64ForRegister:(NSUInteger)index {
+    if(index >= SQLiteQueryTransactionContextRegisterCount) {
+        NSLog(@"[SQLITE] Invalid register %lu", (unsigned long)index);
+        return 0;
+    }
+    return _registers[index];
+}
+
+-(sqlite3_int64)storeLastInsertRowidInRegister:(NSUInteger)index {
+    sqlite3_int64 rowid = self.db ? sqlite3_last_insert_rowid(self.db) : 0;
+    [self setInt64:rowid forRegister:index];
+    return rowid;
+}
+
+#pragma mark - statements
+
+-(sqlite3_stmt*)statementForQuery:(NSString*)query {
+    if(!([query isKindOfClass:[NSString class]] && self.db)) {
+        NSLog(@"[SQLITE] Invalid query usage");
+        return NULL;
+    }
+    
+    if(!self.statementsByQuery) {
+        self.statementsByQuery = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, NULL);
+    }
+    
+    sqlite3_stmt *statement = (sqlite3_stmt*)CFDictionaryGetValue(self.statementsByQuery, (__bridge CFStringRef)query);
+    if(statement) {
+        sqlite3_reset(statement);
+        sqlite3_clear_bindings(statement);
+        return statement;
+    }
+    
+    int prepareResult = self.connection ? [self.connection prepareStatement:&statement forQuery:query cacheHit:NULL] : sqlite3_prepare_v2(self.db, [query UTF8String], -1, &statement, NULL);
+    if(prepareResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to prepare statement %d %s", prepareResult, sqlite3_errmsg(self.db));
+        sqlite3_finalize(statement);
+        return NULL;
+    }
+    
+    CFDictionarySetValue(self.statementsByQuery, (__bridge CFStringRef)[query copy], statement);
+    return statement;
+}
+
+-(void)releaseStatements {
+    CFMutableDictionaryRef statementsByQuery = self.statementsByQuery;
+    if(!statementsByQuery) {
+        return;
+    }
+    self.statementsByQuery = NULL;
+    
+    CFIndex count = CFDictionaryGetCount(statementsByQuery);
+    const void **queries = malloc(sizeof(void*) * MAX(count, 1));
+    const void **statements = malloc(sizeof(void*) * MAX(count, 1));
+    CFDictionaryGetKeysAndValues(statementsByQuery, queries, statements);
+    
+    for(CFIndex index = 0; index < count; ++index) {
+        sqlite3_stmt *statement = (sqlite3_stmt*)statements[index];
+        int finalizeResult = self.connection ? [self.connection releaseStatement:statement forQuery:(__bridge NSString*)queries[index]] : sqlite3_finalize(statement);
+        if(finalizeResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Error failed to finalize prepare statement %d", finalizeResult);
+        }
+    }
+    
+    free(queries);
+    free(statements);
+    CFRelease(statementsByQuery);
+}
+
+#pragma mark - savepoints
+
+-(BOOL)savepointWithOperations:(NSArray*)operations {
+    if(!self.db) {
+        NSLog(@"[SQLITE] Invalid savepoint usage");
+        return NO;
+    }
+    
+    NSString *name = [NSString stringWithFormat:@"query_util_savepoint_%lu", (unsigned long)(self.savepointDepth + 1)];
+    
+    int savepointResponse = sqlite3_exec(self.db, [[NSString stringWithFormat:@"SAVEPOINT %@", name] UTF8String], 0, 0, 0);
+    if(savepointResponse != SQLITE_OK) {
+        NSLog(@"[SQLITE] Savepoint Error: %d %s",savepointResponse, sqlite3_errmsg(self.db));
+        return NO;
+    }
+    ++self.savepointDepth;
+    [self.changeSet beginSavepoint];
+    
+    // registers are not part of the database, keep a copy to undo them with the rollback
+    sqlite3_int64 savedRegisters[SQLiteQueryTransactionContextRegisterCount];
+    memcpy(savedRegisters, _registers, sizeof(_registers));
+    
+    BOOL savepointSucceeded = YES;
+    for(SQLiteQueryUtilTransactionOperation nextOperation in operations) {
+        savepointSucceeded &= nextOperation(self.db, self);
+        
+        if(!savepointSucceeded) {
+            break;
+        }
+    }
+    
+    if(!savepointSucceeded) {
+        int rollbackResponse = sqlite3_exec(self.db, [[NSString stringWithFormat:@"ROLLBACK TO %@", name] UTF8String], 0, 0, 0);
+        if(rollbackResponse != SQLITE_OK) {
+            NSLog(@"[SQLITE] Rollback Error: %d %s",rollbackResponse, sqlite3_errmsg(self.db));
+        }
+        [self.changeSet rollbackToSavepoint];
+        memcpy(_registers, savedRegisters, sizeof(_registers));
+    }
+    
+    int releaseResponse = sqlite3_exec(self.db, [[NSString stringWithFormat:@"RELEASE %@", name] UTF8String], 0, 0, 0);
+    if(releaseResponse != SQLITE_OK) {
+        NSLog(@"[SQLITE] Release Savepoint Error: %d %s",releaseResponse, sqlite3_errmsg(self.db));
+    }
+    [self.changeSet releaseSavepoint];
+    --self.savepointDepth;
+    
+    return savepointSucceeded && releaseResponse == SQLITE_OK;
+}
+
+#pragma mark - NSMutableDictionary
+
+-(NSUInteger)count {
+    return self.values.count;
+}
+
+-(id)objectForKey:(id)aKey {
+    return [self.values objectForKey:aKey];
+}
+
+-(NSEnumerator*)keyEnumerator {
+    return [self.values keyEnumerator] ?: [@[] objectEnumerator];
+}
+
+-(void)setObject:(id)anObject forKey:(id<NSCopying>)aKey {
+    if(!self.values) {
+        self.values = [[NSMutableDictionary alloc] init];
+    }
+    [self.values setObject:anObject forKey:aKey];
+}
+
+-(void)removeObjectForKey:(id)aKey {
+    [self.values removeObjectForKey:aKey];
+}
+
+@end
@@ -28,19 +28,125 @@
 
 #import <Foundation/Foundation.h>
 #import <sqlite3.h>
+#import "SQLiteQueryBindings.h"
+#import "SQLiteQueryBlob.h"
+#import "SQLiteQueryCancellationToken.h"
+#import "SQLiteQueryChangeSet.h"
+#import "SQLiteQueryColumnarResult.h"
+#import "SQLiteQueryCursor.h"
+#import "SQLiteQueryReadSnapshot.h"
+#import "SQLiteQueryRowLayout.h"
+#import "SQLiteQueryTransactionContext.h"
+#import "SQLiteQueryUtilConfiguration.h"
+#import "SQLiteQueryUtilMetrics.h"
+
+/**
+ "identifier" with embedded quotes doubled, for table, column, index and trigger names spliced into sql
+ 
+ @param identifier unquoted name
+ 
+ @return quoted identifier
+ */
+NSString *SQLiteQueryUtilQuoteIdentifier(NSString *identifier);
+
+/**
+ 'literal' with embedded quotes doubled, for text spliced into sql where nothing can be bound, ie trigger bodies
+ 
+ @param literal unquoted text
+ 
+ @return quoted string literal
+ */
+NSString *SQLiteQueryUtilQuoteLiteral(NSString *literal);
 
 @interface SQLiteQueryUtil : NSObject
 
 /**
  Initializes a 'SQLiteQueryUtil' object with the specified local database path
  
+ @param dbPath database path on disk including filename and extension
+ 
+ @return newly-initialized SQLiteQueryUtil
+ */
+-(id)initWithDBPath:(NSString*)dbPath;
+
+/**
+ Initializes a 'SQLiteQueryUtil' object with the specified local database path and PRAGMA profile
+ 
  This is the designated initializer
  
  @param dbPath database path on disk including filename and extension
+ @param configuration optional PRAGMA profile applied once to every connection opened, ie [SQLiteQueryUtilConfiguration throughputConfiguration]
  
  @return newly-initialized SQLiteQueryUtil
  */
--(id)initWithDBPath:(NSString*)dbPath;
+-(id)initWithDBPath:(NSString*)dbPath configuration:(SQLiteQueryUtilConfiguration*)configuration;
+
+/**
+ database path on disk the instance was initialized with
+ */
+@property (nonatomic, readonly, copy) NSString *dbPath;
+
+/**
+ PRAGMA profile applied to every connection opened, nil when none
+ */
+@property (nonatomic, readonly, copy) SQLiteQueryUtilConfiguration *configuration;
+
+/**
+ number of idle read only connections kept open between queries
+ 
+ readers beyond this count are opened on demand and closed when checked back in
+ 0 closes every reader after use. also bounds how many asynchronous reads run at once. defaults to 4
+ */
+@property (nonatomic, assign) NSUInteger readerConnectionPoolSize;
+
+/**
+ closes the idle pooled reader connections and the pooled writer connection
+ 
+ waits for the writer connection if it is in use. readers in use are unaffected
+ */
+-(void)closePooledConnections;
+
+/**
+ number of idle prepared statements each pooled connection keeps for reuse, keyed by query
+ 
+ least recently used statements are finalized first. 0 disables the cache. defaults to 32
+ */
+@property (nonatomic, assign) NSUInteger statementCacheCapacity;
+
+/**
+ number of prepares served from a pooled connection's statement cache
+ */
+@property (nonatomic, readonly) uint64_t statementCacheHitCount;
+
+/**
+ number of prepares on pooled connections that had to call sqlite3_prepare_v2
+ */
+@property (nonatomic, readonly) uint64_t statementCacheMissCount;
+
+/**
+ optional block receiving timing for every queryDB: and writeQueryInDB: execution
+ 
+ called on the thread that executed the statement after the connection is checked back in, keep it cheap
+ nil disables the measurements entirely
+ */
+@property (nonatomic, copy) void (^statementMetricsHandler)(SQLiteQueryStatementMetrics *metrics);
+
+/**
+ seconds after which a statement is slow and its EXPLAIN QUERY PLAN is captured into the metrics. 0 disables
+ */
+@property (nonatomic, assign) NSTimeInterval slowQueryThreshold;
+
+/**
+ optional block receiving attempts, busy retries and timing for every writeTransactionWithOperations: and createTransactionWithOperations:
+ 
+ called on the thread that executed the transaction after the writer is checked back in
+ */
+@property (nonatomic, copy) void (^transactionMetricsHandler)(SQLiteQueryTransactionMetrics *metrics);
+
+/**
+ emit an os_signpost interval per statement so queries show up in Instruments. iOS 12, macOS 10.14 and later
+ */
+@property (nonatomic, assign) BOOL signpostsEnabled;
 
 /**
  read query on db
@@ -62,6 +168,263 @@
  */
 -(void)writeQueryInDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
 
+/**
+ read only query on db binding params by type, see SQLiteQueryBindParams
+ 
+ @param query sqlite query
+ @param params optional NSArray bound to '?' in order or NSDictionary bound to ':name' params
+ @param onNextRowCallback optional block called for every row in query resultset
+ @param onQueryCompleteCallack optional block called when the query completes
+ */
+-(void)queryDB:(NSString*)query withParams:(id)params onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
+
+/**
+ read|write query on db binding params by type, see SQLiteQueryBindParams
+ 
+ @param query sqlite query
+ @param params optional NSArray bound to '?' in order or NSDictionary bound to ':name' params
+ @param onNextRowCallback optional block called for every row in query resultset
+ @param onQueryCompleteCallack optional block called when the query completes
+ */
+-(void)writeQueryInDB:(NSString*)query withParams:(id)params onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
+
+/**
+ read only query on db binding tagged values, buffers are bound SQLITE_STATIC and must stay valid until this returns
+ 
+ @param query sqlite query
+ @param values tagged values bound to params 1..count
+ @param count number of values
+ @param onNextRowCallback optional block called for every row in query resultset
+ @param onQueryCompleteCallack optional block called when the query completes
+ */
+-(void)queryDB:(NSString*)query withBindValues:(const SQLiteQueryBindValue*)values count:(int)count onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
+
+/**
+ read|write query on db binding tagged values, buffers are bound SQLITE_STATIC and must stay valid until this returns
+ 
+ @param query sqlite query
+ @param values tagged values bound to params 1..count
+ @param count number of values
+ @param onNextRowCallback optional block called for every row in query resultset
+ @param onQueryCompleteCallack optional block called when the query completes
+ */
+-(void)writeQueryInDB:(NSString*)query withBindValues:(const SQLiteQueryBindValue*)values count:(int)count onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
+
+/**
+ approximate bytes of query results cachedRowsForQuery: keeps in memory, least recently used are evicted first
+ 
+ results are invalidated by table as soon as the pooled writer's COMMIT of a change to a table they read returns,
+ so the cache is only valid for writes through the pooled writer. writes through openDBReadWrite: connections,
+ caller owned connections or other processes are never seen and must call invalidateResultCacheForTables:
+ 0 disables the cache. defaults to 0
+ */
+@property (nonatomic, assign) NSUInteger resultCacheCapacity;
+
+/**
+ number of cachedRowsForQuery: calls answered from the result cache
+ */
+@property (nonatomic, readonly) NSUInteger resultCacheHitCount;
+
+/**
+ number of cachedRowsForQuery: calls that ran their query
+ */
+@property (nonatomic, readonly) NSUInteger resultCacheMissCount;
+
+/**
+ read query on a pooled read only connection through the result cache
+ 
+ keyed by the query with its bound values. values are boxed NSNumber, NSString, NSData or NSNull
+ 
+ @param query sqlite query
+ @param bindParamsCallback optional block for binding query '?' to values
+ 
+ @return array of rows, each an array of column values. nil if the query failed
+ */
+-(NSArray*)cachedRowsForQuery:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback;
+
+/**
+ cachedRowsForQuery:withBindParamsCallback: binding params by type, see SQLiteQueryBindParams
+ 
+ @param query sqlite select query
+ @param params optional NSArray bound to '?' in order or NSDictionary bound to ':name' params
+ 
+ @return array of rows, each an array of column values, nil if the query failed
+ */
+-(NSArray*)cachedRowsForQuery:(NSString*)query withParams:(id)params;
+
+/**
+ read query on a pooled read only connection collecting its rows column by column
+ 
+ one value buffer, or byte arena with offsets, and one null bitmap per column instead of an object per value
+ 
+ @param query sqlite query
+ @param bindParamsCallback optional block for binding query '?' to values
+ @param columnTypes storage type of each result column, see SQLiteQueryColumnarResult
+ @param columnCount number of columnTypes, at most the query's column count
+ 
+ @return the rows or nil if the query failed
+ */
+-(SQLiteQueryColumnarResult*)columnarResultForQuery:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback columnTypes:(const SQLiteQueryColumnType*)columnTypes columnCount:(NSUInteger)columnCount;
+
+/**
+ drops cached results reading any of tables
+ 
+ @param tables table names, nil drops every cached result
+ */
+-(void)invalidateResultCacheForTables:(NSSet*)tables;
+
+/**
+ optional block receiving the rows changed through the writer, one coalesced change set per writer checkout
+ 
+ changes are recorded by the update hook, or the preupdate hook when sqlite is built with SQLITE_ENABLE_PREUPDATE_HOOK,
+ kept once COMMIT returns SQLITE_OK and dropped when it rolls back, a commit that fails busy delivers nothing.
+ delivered on changeFeedQueue after the writer is released
+ */
+@property (nonatomic, copy) void (^changeFeedHandler)(SQLiteQueryChangeSet *changeSet);
+
+/**
+ queue for changeFeedHandler, nil for the main queue
+ */
+@property (nonatomic, strong) dispatch_queue_t changeFeedQueue;
+
+/**
+ asynchronous read query on a pooled read only connection
+ 
+ runs on the concurrent reader queue. bindParamsCallback and onNextRowCallback are called on the reader queue
+ 
+ @param query sqlite query
+ @param bindParamsCallback optional block for binding query '?' to values
+ @param onNextRowCallback optional block called for every row in query resultset
+ @param completionQueue queue for onQueryCompleteCallack, nil for the main queue
+ @param onQueryCompleteCallack optional block called when the query completes
+ */
+-(void)queryDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback completionQueue:(dispatch_queue_t)completionQueue onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
+
+/**
+ asynchronous read query on a pooled read only connection that can be cancelled or time out
+ 
+ a cancelled or timed out query stops at its next sqlite progress check, rows already delivered stay delivered
+ 
+ @param query sqlite query
+ @param bindParamsCallback optional block for binding query '?' to values
+ @param onNextRowCallback optional block called for every row in query resultset
+ @param cancellationToken optional token, cancel stops the query with sqlite3_interrupt or skips it if not started
+ @param timeout seconds the query may run once started before it is interrupted, 0 for no limit
+ @param completionQueue queue for onQueryCompleteCallack, nil for the main queue
+ @param onQueryCompleteCallack optional block called when the query completes, interrupted is YES if the cancel or timeout stopped
+ it with SQLITE_INTERRUPT or it was cancelled before it started. NO once it ran to the end even if cancelled afterwards
+ */
+-(void)queryDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback cancellationToken:(SQLiteQueryCancellationToken*)cancellationToken timeout:(NSTimeInterval)timeout completionQueue:(dispatch_queue_t)completionQueue onQueryCompleteCallack:(void(^)(BOOL interrupted))onQueryCompleteCallack;
+
+/**
+ read query on a pooled read only connection decoding rows straight into a caller provided array of structs
+ 
+ the whole result set is decoded in one pass without boxing. for text and blob views use
+ cursorForQuery: with -[SQLiteQueryCursor nextIntoRow:layout:] since views are only valid until the next step
+ 
+ @param query sqlite query
+ @param bindParamsCallback optional block for binding query '?' to values
+ @param rowLayout column to field layout, must not contain text or blob views
+ @param rows contiguous array of maxRows structs
+ @param rowSize size of one struct, ie sizeof(Foo)
+ @param maxRows capacity of rows, stepping stops once it is full
+ 
+ @return number of rows decoded into rows
+ */
+-(NSUInteger)queryDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback rowLayout:(SQLiteQueryRowLayout*)rowLayout intoRows:(void*)rows rowSize:(size_t)rowSize maxRows:(NSUInteger)maxRows;
+
+/**
+ a read executed on its own pooled read only connection. returns the result object for the read, nil becomes NSNull
+ */
+typedef id(^SQLiteQueryUtilReadOperation)(sqlite3 *);
+
+/**
+ runs independent reads in parallel, each on its own pooled read only connection
+ 
+ for example the queries behind one screen. readOperations use the withDB: functions on the db they are given
+ 
+ @param readOperations an array of SQLiteQueryUtilReadOperation's
+ @param completionQueue queue for onReadsComplete, nil for the main queue
+ @param onReadsComplete block called once with every read's result in readOperations order. NSNull for nil results or a failed open
+ */
+-(void)performReadOperationsInParallel:(NSArray*)readOperations completionQueue:(dispatch_queue_t)completionQueue onReadsComplete:(void (^)(NSArray *results))onReadsComplete;
+
+/**
+ runs several reads against one consistent database state without blocking writers
+ 
+ one pooled read only connection is checked out for the whole session and a 'BEGIN DEFERRED TRANSACTION'
+ read transaction is started on it, so every query the session runs with the withDB: functions sees the same
+ snapshot while writers keep committing to the wal. cursors opened in the session must be closed before it returns
+ 
+ @param session block running the reads on db
+ 
+ @return session ran inside its read transaction
+ */
+-(BOOL)performReadSession:(void (^)(sqlite3 *db))session;
+
+/**
+ read session started on a shared snapshot, or capturing one for other sessions
+ 
+ @param snapshot snapshot from another session to read, nil reads the latest state and captures it
+ @param session block running the reads on db, given the snapshot it reads. snapshot is nil when SQLiteQueryReadSnapshot isSupported is NO or the db is not in WAL mode
+ 
+ @return session ran inside its read transaction, NO when snapshot could not be opened
+ */
+-(BOOL)performReadSessionOnSnapshot:(SQLiteQueryReadSnapshot*)snapshot session:(void (^)(sqlite3 *db, SQLiteQueryReadSnapshot *snapshot))session;
+
+/**
+ runs independent reads in parallel on pooled read only connections, all reading the same snapshot
+ 
+ the session capturing the snapshot runs on the reader queue like any other read and runs reads itself. readers idle
+ in the pool open the snapshot and take reads alongside it, no connection past readerConnectionPoolSize is opened.
+ the capturing session is held open until every read finished so the wal can not drop the snapshot. without snapshot
+ support or an idle reader the reads run one after another inside that single session, reads a reader that failed to
+ open the snapshot did not take run there too. either way every result comes from the same database state
+ 
+ @param readOperations an array of SQLiteQueryUtilReadOperation's
+ @param completionQueue queue for onReadsComplete, nil for the main queue
+ @param onReadsComplete block called once with every read's result in readOperations order, NSNull for nil results,
+ and how the reads ran. SQLiteQueryConsistentReadModeFailed when the session could not start, every result is NSNull
+ */
+-(void)performConsistentReadOperationsInParallel:(NSArray*)readOperations completionQueue:(dispatch_queue_t)completionQueue onReadsComplete:(void (^)(NSArray *results, SQLiteQueryConsistentReadMode mode))onReadsComplete;
+
+
+/**
+ read query on a pooled read only connection returning a cursor over its rows
+ 
+ the statement is stepped only when next is called so callers can stop early
+ the pooled connection stays checked out until the cursor is closed or exhausted
+ 
+ @param query sqlite query
+ @param bindParamsCallback optional block for binding query '?' to values
+ 
+ @return open cursor or nil if the db could not be opened or the query not prepared
+ */
+-(SQLiteQueryCursor*)cursorForQuery:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback;
+
+/**
+ cursorForQuery:withBindParamsCallback: binding params by type, params are kept alive until the cursor closes
+ 
+ @param query sqlite query
+ @param params optional NSArray bound to '?' in order or NSDictionary bound to ':name' params
+ 
+ @return cursor positioned before the first row, nil if the query could not be prepared
+ */
+-(SQLiteQueryCursor*)cursorForQuery:(NSString*)query withParams:(id)params;
+
+/**
+ opens a blob for incremental i/o, read only blobs use a pooled read only connection and writable blobs the writer
+ 
+ the connection stays checked out until the blob is closed, writes become visible to readers once it is
+ 
+ @param table table name
+ @param column blob column name
+ @param rowid rowid of the row holding the blob
+ @param readOnly NO to open for writing
+ 
+ @return open blob or nil if the db or blob could not be opened
+ */
+-(SQLiteQueryBlob*)openBlobInTable:(NSString*)table column:(NSString*)column rowid:(sqlite3_int64)rowid readOnly:(BOOL)readOnly;
 
 /**
  user_version of the sqllite database
@@ -120,6 +483,99 @@
  */
 -(void)enumerateObjectsMatchingQuery:(NSString*)query countQuery:(NSString*)countQuery bufferSize:(NSUInteger)bufferSize withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
 
+/**
+ uses keyset (seek) pagination to iterate over a query's result set in keyColumn order
+ 
+ pages with 'WHERE keyColumn >= ? ORDER BY keyColumn LIMIT ?' on one reused prepared statement, each page starting past the last key
+ so every page is an index seek and no count query is needed. the statement is reset
+ between pages so no read transaction is held across the whole enumeration
+ 
+ the key must be a unique INTEGER result column. rowid is not visible through the subquery the pages are read from,
+ so it has to be selected under a name. a key of another type or a repeated key stops the enumeration with an error
+ logged, since text keys sort after every integer and a tie at a page boundary would be skipped
+ 
+ @param query sqlite query. must not contain a trailing ;, ORDER BY or LIMIT and must return keyColumn as a named result column, ie 'select rowid as id, name from foo'
+ @param keyColumn unique INTEGER result column to order and seek by, required
+ @param bufferSize number of results to retrieve per pass
+ @param dbToUse database reference
+ @param bindParamsCallback optional block for binding query '?' to values. called once
+ @param onNextRowCallback optional block called for every row in query resultset
+ @param onQueryCompleteCallack optional block called once when the enumeration completes
+ */
+-(void)enumerateObjectsMatchingQuery:(NSString*)query keyColumn:(NSString*)keyColumn bufferSize:(NSUInteger)bufferSize withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
+
+/**
+ keyset pagination on a pooled read only connection
+ 
+ @see enumerateObjectsMatchingQuery:keyColumn:bufferSize:withDB:withBindParamsCallback:onNextRowCallback:onQueryCompleteCallack:
+ */
+-(void)enumerateObjectsMatchingQuery:(NSString*)query keyColumn:(NSString*)keyColumn bufferSize:(NSUInteger)bufferSize withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
+
+/**
+ counts the rows of a query as 'SELECT COUNT(*) FROM (query)' on a pooled read only connection, the statement is cached like any other query
+ 
+ @param query sqlite query. must not contain a trailing ;
+ @param params NSArray for '?' params or NSDictionary for named params, nil for none
+ 
+ @return row count, -1 if the query failed
+ */
+-(sqlite3_int64)countOfQuery:(NSString*)query withParams:(id)params;
+
+/**
+ counts the rows of a query on the given connection
+ 
+ @param query sqlite query. must not contain a trailing ;
+ @param dbToUse database reference
+ @param bindParamsCallback optional block for binding query '?' to values
+ 
+ @return row count, -1 if the query failed
+ */
+-(sqlite3_int64)countOfQuery:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback;
+
+/**
+ checks whether a query returns any row as 'SELECT EXISTS(SELECT 1 FROM (query) LIMIT 1)', stepping stops at the first match
+ 
+ @param query sqlite query. must not contain a trailing ;
+ @param params NSArray for '?' params or NSDictionary for named params, nil for none
+ 
+ @return query returned at least one row
+ */
+-(BOOL)existsForQuery:(NSString*)query withParams:(id)params;
+
+/**
+ checks whether a query returns any row on the given connection
+ 
+ @param query sqlite query. must not contain a trailing ;
+ @param dbToUse database reference
+ @param bindParamsCallback optional block for binding query '?' to values
+ 
+ @return query returned at least one row
+ */
+-(BOOL)existsForQuery:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback;
+
+/**
+ keeps an exact row count of table in query_util_row_count using insert and delete triggers, seeded with a single full count
+ 
+ rows deleted by a REPLACE conflict (INSERT OR REPLACE, REPLACE, UPDATE OR REPLACE, ON CONFLICT REPLACE constraints) do not fire delete triggers unless
+ PRAGMA recursive_triggers is on for the writing connection, so the replaced rows are never subtracted and the count drifts up.
+ tables written that way should not use the counter, or call this again after those writes to reseed it
+ 
+ @param table table to count
+ 
+ @return triggers created and count seeded
+ */
+-(BOOL)maintainRowCountForTable:(NSString*)table;
+
+/**
+ row count of table, without scanning it when possible. reads the counter kept by maintainRowCountForTable:, otherwise the
+ estimate ANALYZE stored in sqlite_stat1, otherwise falls back to an exact COUNT(*) scan
+ 
+ @param table table to count
+ 
+ @return kept, estimated or scanned row count, -1 if table can not be read
+ */
+-(sqlite3_int64)approximateCountOfTable:(NSString*)table;
+
 /**
  workflow for migrations
  
@@ -156,6 +612,42 @@
  */
 -(void)writeQueryInDB:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack;
 
+/**
+ read query on db returning a cursor over its rows
+ 
+ the cursor must be closed before the caller closes db
+ 
+ @param query sqlite query
+ @param dbToUse database reference
+ @param bindParamsCallback optional block for binding query '?' to values
+ 
+ @return open cursor or nil if the query could not be prepared
+ */
+-(SQLiteQueryCursor*)cursorForQuery:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback;
+
+/**
+ opens a blob for incremental i/o on db
+ 
+ the blob must be closed before the caller closes db
+ 
+ @see openBlobInTable:column:rowid:readOnly:
+ */
+-(SQLiteQueryBlob*)openBlobInTable:(NSString*)table column:(NSString*)column rowid:(sqlite3_int64)rowid readOnly:(BOOL)readOnly withDB:(sqlite3**)dbToUse;
+
+/**
+ read query on db collecting its rows column by column
+ 
+ @see columnarResultForQuery:withBindParamsCallback:columnTypes:columnCount:
+ */
+-(SQLiteQueryColumnarResult*)columnarResultForQuery:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback columnTypes:(const SQLiteQueryColumnType*)columnTypes columnCount:(NSUInteger)columnCount;
+
+/**
+ read query on db decoding rows straight into a caller provided array of structs
+ 
+ @see queryDB:withBindParamsCallback:rowLayout:intoRows:rowSize:maxRows:
+ */
+-(NSUInteger)queryDB:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback rowLayout:(SQLiteQueryRowLayout*)rowLayout intoRows:(void*)rows rowSize:(size_t)rowSize maxRows:(NSUInteger)maxRows;
+
 /**
  user_version of the sqllite database
  
@@ -175,8 +667,6 @@
  */
 -(BOOL)setdbVersion:(int32_t)updatedVersion withDB:(sqlite3**)db;
 
-typedef BOOL(^SQLiteQueryUtilTransactionOperation)(sqlite3 *, NSMutableDictionary *);
-
 /**
  block wrapper for a sqlite transaction
  
@@ -193,10 +683,12 @@ typedef BOOL(^SQLiteQueryUtilTransactionOperation)(sqlite3 *, NSMutableDictionar
  if all operationsInTransaction return success the transaction is committed
  else the transaction is rolled back
  for example many insert statements that should be executed atomically on the database
+ called from an operation of a transaction on the writer it runs as a savepoint of that transaction through its context's
+ savepointWithOperations:, the enclosing transaction commits or rolls back the work
  
  @prarm operationsInTransaction an array of SQLiteQueryUtilTransactionOperation's
  
- @return successfully committed all operationsInTransaction
+ @return successfully committed all operationsInTransaction, or released their savepoint when nested
  */
 -(BOOL)writeTransactionWithOperations:(NSArray*)operationsInTransaction;
 
@@ -205,10 +697,304 @@ typedef BOOL(^SQLiteQueryUtilTransactionOperation)(sqlite3 *, NSMutableDictionar
  if all operationsInTransaction return success the transaction is committed
  else the transaction is rolled back
  for example many insert statements that should be executed atomically on the database
+ nests as a savepoint like writeTransactionWithOperations:
  
  @prarm operationsInTransaction an array of SQLiteQueryUtilTransactionOperation's
  
- @return successfully committed all operationsInTransaction
+ @return successfully committed all operationsInTransaction, or released their savepoint when nested
  */
 -(BOOL)createTransactionWithOperations:(NSArray*)operationsInTransaction;
+
+/**
+ inserts rows into table reusing one prepared insert statement
+ 
+ every chunkSize rows are committed in their own 'begin immediate transaction'
+ values are bound by type: NSNumber int64|double, NSString text, NSData blob, NSNull null
+ 
+ @param table table name, unquoted. it is quoted as an identifier
+ @param columns array of column names, one per value in each row, unquoted like table
+ @param rows array of arrays of values in columns order
+ 
+ @return successfully committed every row
+ */
+-(BOOL)bulkInsertIntoTable:(NSString*)table columns:(NSArray*)columns rows:(NSArray*)rows;
+
+/**
+ inserts rowCount rows into table, the rows are bound by rowProvider directly on the insert statement
+ 
+ with rowsPerStatement > 1 a multi row 'insert .. values (..),(..)' statement is used, capped so it
+ never exceeds the connection's SQLITE_LIMIT_VARIABLE_NUMBER. statements are prepared once and reused
+ a failed chunk is rolled back and stops the insert, earlier chunks stay committed
+ 
+ @param table table name, unquoted. it is quoted as an identifier
+ @param columns array of column names, unquoted like table
+ @param rowsPerStatement rows bound per insert statement execution, 1 for a single row insert
+ @param chunkSize rows committed per transaction, 0 for a single transaction
+ @param rowCount number of rows to insert
+ @param rowProvider binds row's columns starting at firstParamIndex, return NO to abort the insert
+ 
+ @return successfully committed every row
+ */
+-(BOOL)bulkInsertIntoTable:(NSString*)table columns:(NSArray*)columns rowsPerStatement:(NSUInteger)rowsPerStatement chunkSize:(NSUInteger)chunkSize rowCount:(NSUInteger)rowCount rowProvider:(BOOL (^)(sqlite3_stmt *insertStatement, int firstParamIndex, NSUInteger row))rowProvider;
+
+/**
+ seconds a pooled connection retries a locked database, and a transaction is rerun after SQLITE_BUSY, before giving up
+ 
+ retries back off exponentially from busyRetryBaseDelay to busyRetryMaxDelay with jitter
+ sqlite allows one busy handler per connection, so on pooled connections this handler replaces the sqlite3_busy_timeout
+ of the configuration's busyTimeout. defaults to the configuration's busyTimeout when set, otherwise 2.
+ 0 disables the handler and pooled connections wait with the configuration's busyTimeout instead
+ a retried transaction runs its operations again, they must not depend on state from a failed attempt
+ */
+@property (nonatomic, assign) NSTimeInterval busyRetryDeadline;
+
+/**
+ seconds before the first busy retry. defaults to 0.002
+ */
+@property (nonatomic, assign) NSTimeInterval busyRetryBaseDelay;
+
+/**
+ upper bound of the delay between two busy retries. defaults to 0.1
+ */
+@property (nonatomic, assign) NSTimeInterval busyRetryMaxDelay;
+
+/**
+ max number of enqueued write transactions coalesced into one commit. defaults to 64
+ */
+@property (nonatomic, assign) NSUInteger groupCommitMaxTransactions;
+
+/**
+ seconds an enqueued write transaction waits for others to join its commit. defaults to 0.002
+ */
+@property (nonatomic, assign) NSTimeInterval groupCommitMaxDelay;
+
+/**
+ asynchronously execute an array of write operations on the serial writer queue
+ 
+ pending transactions are coalesced, up to groupCommitMaxTransactions or groupCommitMaxDelay,
+ into one 'begin immediate transaction' and one commit. each enqueued transaction runs inside
+ its own savepoint so a failing one is rolled back without affecting the others in the group
+ operations must not begin, commit or rollback themselves
+ 
+ @prarm operationsInTransaction an array of SQLiteQueryUtilTransactionOperation's
+ @param completionQueue queue for onTransactionComplete, nil for the main queue
+ @param onTransactionComplete optional block called with YES when all operationsInTransaction succeeded and the group committed
+ */
+-(void)enqueueWriteTransactionWithOperations:(NSArray*)operationsInTransaction completionQueue:(dispatch_queue_t)completionQueue onTransactionComplete:(void (^)(BOOL transactionSucceeded))onTransactionComplete;
+
+/**
+ asynchronously copies the database to path with sqlite3_backup on a background queue
+ 
+ each step copies pagesPerStep pages holding the writer only for that step so writes keep flowing in between,
+ writes made between steps are carried into the copy
+ 
+ @param path destination file, replaced if it exists
+ @param pagesPerStep pages copied per step, <= 0 copies everything in one step
+ @param progress optional block called on completionQueue after each step with the pages left and the total page count
+ @param completionQueue queue for progress and onBackupComplete, nil for the main queue
+ @param onBackupComplete optional block called with YES once every page was copied
+ */
+-(void)backupToPath:(NSString*)path pagesPerStep:(int)pagesPerStep progress:(void (^)(int remainingPages, int pageCount))progress completionQueue:(dispatch_queue_t)completionQueue onBackupComplete:(void (^)(BOOL backupSucceeded))onBackupComplete;
+
+/**
+ asynchronously writes a vacuumed copy of the database to path with 'VACUUM INTO' on a pooled read only connection
+ 
+ the copy is compacted and consistent as of the start of the vacuum, writers are not blocked. requires sqlite 3.27
+ 
+ @param path destination file, must not exist
+ @param completionQueue queue for onVacuumComplete, nil for the main queue
+ @param onVacuumComplete optional block called with YES once the copy was written
+ */
+-(void)vacuumIntoPath:(NSString*)path completionQueue:(dispatch_queue_t)completionQueue onVacuumComplete:(void (^)(BOOL vacuumSucceeded))onVacuumComplete;
+
+/**
+ registers the schema change taking the database to version, see runMigrations
+ 
+ @param version user_version after the migration
+ @param statements sql executed in order, each may hold several ';' separated statements
+ */
+-(void)registerMigrationToVersion:(int32_t)version statements:(NSArray*)statements;
+
+/**
+ registers the schema change taking the database to version, see runMigrations
+ 
+ @param version user_version after the migration
+ @param operations an array of SQLiteQueryUtilTransactionOperation's
+ */
+-(void)registerMigrationToVersion:(int32_t)version operations:(NSArray*)operations;
+
+/**
+ runs every registered migration above the database's user_version in version order
+ 
+ each migration runs in one 'begin immediate transaction' together with its user_version bump,
+ a failed migration rolls back leaving the database at the previous version and later ones are not run
+ 
+ @return YES if the database is at the highest registered version
+ */
+-(BOOL)runMigrations;
+
+/**
+ a chunk of a backfill run inside its own transaction with the backfill's checkpoint
+ 
+ update at most chunkSize rows after *lastKey, set *lastKey to the last key updated and *finished once nothing is left
+ return NO to roll the chunk back and stop the backfill until the next runBackfills
+ */
+typedef BOOL(^SQLiteQueryUtilBackfillChunk)(sqlite3 *db, sqlite3_int64 *lastKey, NSUInteger chunkSize, BOOL *finished);
+
+/**
+ registers a data backfill that runs in chunks once the database is at version, see runBackfillsWithCompletionQueue:onBackfillsComplete:
+ 
+ @param name unique name the checkpoint is stored under
+ @param version user_version the backfill needs
+ @param chunkSize rows per chunk, passed to chunk
+ @param chunk block processing one chunk, the first chunk gets a lastKey of 0
+ */
+-(void)registerBackfillNamed:(NSString*)name forVersion:(int32_t)version chunkSize:(NSUInteger)chunkSize chunk:(SQLiteQueryUtilBackfillChunk)chunk;
+
+/**
+ asynchronously runs unfinished backfills on a background queue
+ 
+ each chunk commits with its checkpoint in the query_util_backfill table so a backfill interrupted by a crash
+ or relaunch resumes after its last committed chunk. the writer is released between chunks
+ 
+ @param completionQueue queue for onBackfillsComplete, nil for the main queue
+ @param onBackfillsComplete optional block called with YES once every backfill whose version was reached has finished
+ */
+-(void)runBackfillsWithCompletionQueue:(dispatch_queue_t)completionQueue onBackfillsComplete:(void (^)(BOOL backfillsFinished))onBackfillsComplete;
+
+/**
+ queries prepared on every connection by warmUpWithCompletionQueue:onWarmUpComplete: so their first run skips the prepare
+ */
+@property (nonatomic, copy) NSArray *hotQueries;
+
+/**
+ seconds from init to the first successful queryDB: or writeQueryInDB:, 0 until one completes
+ */
+@property (nonatomic, readonly) NSTimeInterval timeToFirstQuery;
+
+/**
+ asynchronously opens the reader pool and the writer on a background queue before they are needed
+ 
+ each connection loads the schema, prepares hotQueries into its statement cache and touches every index but partial ones
+ 
+ @param completionQueue queue for onWarmUpComplete, nil for the main queue
+ @param onWarmUpComplete optional block called with the seconds the warm up took
+ */
+-(void)warmUpWithCompletionQueue:(dispatch_queue_t)completionQueue onWarmUpComplete:(void (^)(NSTimeInterval warmUpDuration))onWarmUpComplete;
+
+/**
+ seconds without a write before a PASSIVE wal checkpoint runs on a background queue. default 0 leaves checkpoints to sqlite
+ 
+ when set the writer's wal_autocheckpoint is disabled so commits never pay for a checkpoint
+ */
+@property (nonatomic, assign) NSTimeInterval walCheckpointIdleDelay;
+
+/**
+ bytes of -wal file past which the idle checkpoint escalates to TRUNCATE, waiting on readers, to reclaim the file
+ below it the idle checkpoint stays PASSIVE and frames pinned by readers wait for the next one. default 16MB
+ */
+@property (nonatomic, assign) unsigned long long walCheckpointSizeLimit;
+
+/**
+ optional block receiving the outcome of every scheduled checkpoint, called on a background queue
+ */
+@property (nonatomic, copy) void (^checkpointMetricsHandler)(SQLiteQueryCheckpointMetrics *metrics);
+
+/**
+ runs a wal checkpoint now on a separate read|write connection so the writer is not held
+ 
+ the connection is opened on first use and kept for later checkpoints, closed with the pool or on critical memory pressure
+ 
+ @param mode SQLITE_CHECKPOINT_PASSIVE, SQLITE_CHECKPOINT_FULL, SQLITE_CHECKPOINT_RESTART or SQLITE_CHECKPOINT_TRUNCATE
+ 
+ @return checkpoint outcome
+ */
+-(SQLiteQueryCheckpointMetrics*)checkpointWithMode:(int)mode;
+
+/**
+ process wide soft limit on sqlite heap usage, sqlite3_soft_heap_limit64. sqlite recycles page cache before exceeding it
+ 
+ @param softHeapLimit bytes, 0 for no limit
+ */
++(void)setSoftHeapLimit:(sqlite3_int64)softHeapLimit;
+
+/**
+ @return the current process wide soft heap limit in bytes, 0 for none
+ */
++(sqlite3_int64)softHeapLimit;
+
+/**
+ release memory when the system reports memory pressure, default NO
+ 
+ a warning calls releaseMemoryClosingIdleConnections:NO, critical pressure releaseMemoryClosingIdleConnections:YES
+ */
+@property (nonatomic, assign) BOOL releasesMemoryOnPressure;
+
+/**
+ frees page cache with sqlite3_db_release_memory on the idle pooled connections and the writer and empties the result cache.
+ checked out readers free theirs when checked in
+ 
+ @param closeIdleConnections also close the idle pooled readers and drop the cached statements of the writer and of the
+ checked out readers, they are reopened and reprepared on demand
+ */
+-(void)releaseMemoryClosingIdleConnections:(BOOL)closeIdleConnections;
+
+/**
+ process wide sqlite heap usage along with page cache, statement and schema memory of the pooled connections and the writer,
+ checked out readers as measured when they were checked out
+ 
+ @return current memory status
+ */
+-(SQLiteQueryMemoryStatus*)memoryStatus;
+
+typedef NS_OPTIONS(NSUInteger, SQLiteQueryFunctionOptions) {
+    SQLiteQueryFunctionOptionDeterministic = 1 << 0, // same result for the same arguments, usable in indexes and constant folded
+    SQLiteQueryFunctionOptionInnocuous     = 1 << 1, // no side effects, usable in triggers and views when trusted_schema is off. sqlite 3.31
+    SQLiteQueryFunctionOptionDirectOnly    = 1 << 2  // only callable from top level sql, never from schema. sqlite 3.30
+};
+
+/**
+ body of a scalar function or the step of an aggregate or window function
+ set the result with sqlite3_result_*, keep aggregate state in sqlite3_aggregate_context
+ */
+typedef void(^SQLiteQueryUtilFunctionBlock)(sqlite3_context *context, int argc, sqlite3_value **argv);
+
+/**
+ final or current value of an aggregate or window function, set with sqlite3_result_*
+ */
+typedef void(^SQLiteQueryUtilFunctionResultBlock)(sqlite3_context *context);
+
+/**
+ registers a scalar sql function on every connection, pooled connections already open pick it up at their next checkout
+ 
+ @param name function name
+ @param argumentCount number of arguments, -1 for any
+ @param options SQLiteQueryFunctionOptions
+ @param function function body
+ */
+-(void)registerScalarFunctionNamed:(NSString*)name argumentCount:(int)argumentCount options:(SQLiteQueryFunctionOptions)options function:(SQLiteQueryUtilFunctionBlock)function;
+
+/**
+ registers an aggregate sql function on every connection
+ 
+ @param name function name
+ @param argumentCount number of arguments, -1 for any
+ @param options SQLiteQueryFunctionOptions
+ @param step called for every row
+ @param final called once to set the result
+ */
+-(void)registerAggregateFunctionNamed:(NSString*)name argumentCount:(int)argumentCount options:(SQLiteQueryFunctionOptions)options step:(SQLiteQueryUtilFunctionBlock)step final:(SQLiteQueryUtilFunctionResultBlock)final;
+
+/**
+ registers an aggregate window sql function on every connection. iOS 12, macOS 10.14 and later
+ 
+ @param name function name
+ @param argumentCount number of arguments, -1 for any
+ @param options SQLiteQueryFunctionOptions
+ @param step called for every row added to the window
+ @param final called once to set the result
+ @param value called to set the result for the current window
+ @param inverse called for every row removed from the window
+ */
+-(void)registerWindowFunctionNamed:(NSString*)name argumentCount:(int)argumentCount options:(SQLiteQueryFunctionOptions)options step:(SQLiteQueryUtilFunctionBlock)step final:(SQLiteQueryUtilFunctionResultBlock)final value:(SQLiteQueryUtilFunctionResultBlock)value inverse:(SQLiteQueryUtilFunctionBlock)inverse;
 @end
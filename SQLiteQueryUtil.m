@@ -25,434 +25,3145 @@
 // THE SOFTWARE.
 
 #import "SQLiteQueryUtil.h"
+#import "SQLiteQueryConnection.h"
+#import "SQLiteQueryResultCache.h"
+#import <stdatomic.h>
+#import <mach/mach_time.h>
+#import <os/signpost.h>
+#import <sys/stat.h>
+
+static const NSUInteger SQLiteQueryUtilDefaultReaderConnectionPoolSize = 4;
+static const NSUInteger SQLiteQueryUtilDefaultStatementCacheCapacity = 32;
+static const NSUInteger SQLiteQueryUtilDefaultGroupCommitMaxTransactions = 64;
+static const NSTimeInterval SQLiteQueryUtilDefaultGroupCommitMaxDelay = 0.002;
+static const NSTimeInterval SQLiteQueryUtilDefaultBusyRetryDeadline = 2.0;
+static const NSTimeInterval SQLiteQueryUtilDefaultBusyRetryBaseDelay = 0.002;
+static const NSTimeInterval SQLiteQueryUtilDefaultBusyRetryMaxDelay = 0.1;
+static const NSUInteger SQLiteQueryUtilDefaultBulkInsertRowsPerStatement = 32;
+static const NSUInteger SQLiteQueryUtilDefaultBulkInsertChunkSize = 10000;
+static const NSTimeInterval SQLiteQueryUtilBackupStepDelay = 0.005;
+static const NSTimeInterval SQLiteQueryUtilBackfillChunkDelay = 0.005;
+static const int SQLiteQueryUtilProgressHandlerInterval = 1000;
+static const unsigned long long SQLiteQueryUtilDefaultWALCheckpointSizeLimit = 16 * 1024 * 1024;
+
+static uint64_t SQLiteQueryUtilTimestamp(void) {
+    return mach_absolute_time();
+}
+
+static NSTimeInterval SQLiteQueryUtilSecondsBetween(uint64_t start, uint64_t end) {
+    static mach_timebase_info_data_t timebase;
+    if(timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+    return (NSTimeInterval)((end - start) * timebase.numer / timebase.denom) / NSEC_PER_SEC;
+}
+
+static os_log_t SQLiteQueryUtilSignpostLog(void) API_AVAILABLE(ios(12.0), macos(10.14), tvos(12.0), watchos(5.0)) {
+    static os_log_t signpostLog;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        signpostLog = os_log_create("SQLiteQueryUtil", "queries");
+    });
+    return signpostLog;
+}
+
+// a write transaction waiting on the writer queue for the next group commit
+@interface SQLiteQueryUtilPendingWrite : NSObject
+@property (nonatomic, copy) NSArray *operationsInTransaction;
+@property (nonatomic, strong) dispatch_queue_t completionQueue;
+@property (nonatomic, copy) void (^onTransactionComplete)(BOOL transactionSucceeded);
+@property (nonatomic, assign) BOOL transactionSucceeded;
+@end
+
+@implementation SQLiteQueryUtilPendingWrite
+@end
+
+// a registered backfill and its checkpoint once loaded
+@interface SQLiteQueryUtilBackfill : NSObject
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, assign) int32_t version;
+@property (nonatomic, assign) NSUInteger chunkSize;
+@property (nonatomic, copy) SQLiteQueryUtilBackfillChunk chunk;
+@end
+
+@implementation SQLiteQueryUtilBackfill
+@end
+
+// a registered sql function, each connection it is created on holds a reference
+@interface SQLiteQueryUtilFunction : NSObject
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, assign) int argumentCount;
+@property (nonatomic, assign) SQLiteQueryFunctionOptions options;
+@property (nonatomic, copy) SQLiteQueryUtilFunctionBlock function;
+@property (nonatomic, copy) SQLiteQueryUtilFunctionBlock step;
+@property (nonatomic, copy) SQLiteQueryUtilFunctionResultBlock final;
+@property (nonatomic, copy) SQLiteQueryUtilFunctionResultBlock value;
+@property (nonatomic, copy) SQLiteQueryUtilFunctionBlock inverse;
+@end
+
+@implementation SQLiteQueryUtilFunction
+@end
+
+static void SQLiteQueryUtilFunctionCall(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    SQLiteQueryUtilFunction *function = (__bridge SQLiteQueryUtilFunction *)sqlite3_user_data(context);
+    function.function(context, argc, argv);
+}
+
+static void SQLiteQueryUtilFunctionStep(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    SQLiteQueryUtilFunction *function = (__bridge SQLiteQueryUtilFunction *)sqlite3_user_data(context);
+    function.step(context, argc, argv);
+}
+
+static void SQLiteQueryUtilFunctionFinal(sqlite3_context *context) {
+    SQLiteQueryUtilFunction *function = (__bridge SQLiteQueryUtilFunction *)sqlite3_user_data(context);
+    function.final(context);
+}
+
+static void SQLiteQueryUtilFunctionValue(sqlite3_context *context) {
+    SQLiteQueryUtilFunction *function = (__bridge SQLiteQueryUtilFunction *)sqlite3_user_data(context);
+    function.value(context);
+}
+
+static void SQLiteQueryUtilFunctionInverse(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    SQLiteQueryUtilFunction *function = (__bridge SQLiteQueryUtilFunction *)sqlite3_user_data(context);
+    function.inverse(context, argc, argv);
+}
+
+// xDestroy, drops the connection's reference once the function is replaced or the connection closes
+static void SQLiteQueryUtilFunctionDestroy(void *userData) {
+    CFBridgingRelease(userData);
+}
 
 @interface SQLiteQueryUtil()
 @property (nonatomic, copy) NSString *dbPath;
+@property (nonatomic, copy) SQLiteQueryUtilConfiguration *configuration;
+
+// every pooled connection keyed by its sqlite3 handle, idle or checked out
+@property (nonatomic, assign) CFMutableDictionaryRef pooledConnectionsByDB;
+@property (nonatomic, strong) NSObject *poolLock;
+@property (nonatomic, strong) NSMutableArray *idleReaderConnections;
+
+// checked out reader -> its memory status measured at checkout, they can not be measured while another thread uses them
+@property (nonatomic, strong) NSMapTable *checkedOutReaderStatuses;
+// checked out reader -> whether its statement cache is dropped too, memory released while it was out is released at checkin
+@property (nonatomic, strong) NSMapTable *pendingReaderMemoryReleases;
+
+// single writer, recursive so operations inside a transaction can reuse it on the same thread
+@property (nonatomic, strong) SQLiteQueryConnection *writerConnection;
+@property (nonatomic, strong) NSRecursiveLock *writerLock;
+@property (nonatomic, assign) NSUInteger writerCheckoutDepth;
+// context of the transaction running on the writer, only touched while holding it
+@property (nonatomic, strong) SQLiteQueryTransactionContext *writerTransactionContext;
+
+// concurrent reads, bounded by readerConnectionPoolSize
+@property (nonatomic, strong) NSOperationQueue *readerQueue;
+
+@property (nonatomic, strong) SQLiteQueryResultCache *resultCache;
+
+// group commit
+@property (nonatomic, strong) dispatch_queue_t writerQueue;
+@property (nonatomic, strong) NSMutableArray *pendingWrites;
+@property (nonatomic, assign) BOOL groupCommitScheduled;
+
+// backups, vacuums and other long running work off the caller's queue
+@property (nonatomic, strong) dispatch_queue_t maintenanceQueue;
+
+// version -> operations, backfills in registration order
+@property (nonatomic, strong) NSMutableDictionary *migrationsByVersion;
+@property (nonatomic, strong) NSMutableArray *backfills;
+
+// change feed, only touched while holding the writer. pending until its transaction commits
+@property (nonatomic, strong) SQLiteQueryChangeSet *pendingChanges;
+@property (nonatomic, strong) SQLiteQueryChangeSet *committedChanges;
+
+// bumped by every write, a scheduled checkpoint only runs if no write came after it
+@property (nonatomic, assign) NSUInteger checkpointGeneration;
+
+// read|write connection kept for checkpoints so they neither hold the writer nor reopen for every run
+@property (nonatomic, assign) sqlite3 *checkpointDB;
+@property (nonatomic, strong) NSObject *checkpointLock;
+
+// memory pressure source while releasesMemoryOnPressure is set
+@property (nonatomic, strong) dispatch_source_t memoryPressureSource;
+
+// registered sql functions by name and argument count, generation bumps on every registration
+@property (nonatomic, strong) NSMutableDictionary *functionsByKey;
+@property (nonatomic, assign) NSUInteger functionGeneration;
 @end
 
-@implementation SQLiteQueryUtil
+// sqlite3_update_hook on the pooled writer, context is the unretained SQLiteQueryUtil
+static void SQLiteQueryUtilUpdateHook(void *context, int operation, const char *dbName, const char *table, sqlite3_int64 rowid) {
+    SQLiteQueryUtil *queryUtil = (__bridge SQLiteQueryUtil *)context;
+    [queryUtil.resultCache noteChangedTable:table];
+    
+#ifndef SQLITE_ENABLE_PREUPDATE_HOOK
+    if(queryUtil.changeFeedHandler) {
+        [queryUtil.pendingChanges recordOperation:(SQLiteQueryChangeOperation)operation onTable:table rowid:rowid];
+    }
+#endif
+}
+
+#ifdef SQLITE_ENABLE_PREUPDATE_HOOK
+// sqlite3_preupdate_hook on the pooled writer, unlike the update hook it sees rowid changes and WITHOUT ROWID tables
+static void SQLiteQueryUtilPreupdateHook(void *context, sqlite3 *db, int operation, const char *dbName, const char *table, sqlite3_int64 oldRowid, sqlite3_int64 newRowid) {
+    SQLiteQueryUtil *queryUtil = (__bridge SQLiteQueryUtil *)context;
+    if(!queryUtil.changeFeedHandler) {
+        return;
+    }
+    
+    if(operation == SQLITE_UPDATE && oldRowid != newRowid) {
+        [queryUtil.pendingChanges recordOperation:SQLiteQueryChangeOperationDelete onTable:table rowid:oldRowid];
+        [queryUtil.pendingChanges recordOperation:SQLiteQueryChangeOperationInsert onTable:table rowid:newRowid];
+    }
+    else {
+        [queryUtil.pendingChanges recordOperation:(SQLiteQueryChangeOperation)operation onTable:table rowid:operation == SQLITE_DELETE ? oldRowid : newRowid];
+    }
+}
+#endif
+
+// sqlite3_rollback_hook on the pooled writer
+static void SQLiteQueryUtilRollbackHook(void *context) {
+    SQLiteQueryUtil *queryUtil = (__bridge SQLiteQueryUtil *)context;
+    [queryUtil.resultCache discardPendingInvalidations];
+    [queryUtil.pendingChanges removeAllChanges];
+}
+
+// what the progress handler checks while an interruptible query runs
+typedef struct {
+    __unsafe_unretained SQLiteQueryCancellationToken *cancellationToken;
+    uint64_t startTime;
+    NSTimeInterval timeout;
+} SQLiteQueryUtilProgressContext;
+
+// sqlite3_progress_handler, non zero stops the running statement with SQLITE_INTERRUPT
+static int SQLiteQueryUtilProgressHandler(void *context) {
+    SQLiteQueryUtilProgressContext *progressContext = (SQLiteQueryUtilProgressContext *)context;
+    
+    if(progressContext->cancellationToken.isCancelled ||
+       (progressContext->timeout > 0 && SQLiteQueryUtilSecondsBetween(progressContext->startTime, SQLiteQueryUtilTimestamp()) >= progressContext->timeout)) {
+        return 1;
+    }
+    return 0;
+}
+
+NSString *SQLiteQueryUtilQuoteIdentifier(NSString *identifier) {
+    return [NSString stringWithFormat:@"\"%@\"", [identifier stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""]];
+}
+
+NSString *SQLiteQueryUtilQuoteLiteral(NSString *literal) {
+    return [NSString stringWithFormat:@"'%@'", [literal stringByReplacingOccurrencesOfString:@"'" withString:@"''"]];
+}
+
+// boxed value of a result column
+static id SQLiteQueryUtilColumnValue(sqlite3_stmt *statement, int column) {
+    switch(sqlite3_column_type(statement, column)) {
+        case SQLITE_INTEGER:
+            return @(sqlite3_column_int64(statement, column));
+        case SQLITE_FLOAT:
+            return @(sqlite3_column_double(statement, column));
+        case SQLITE_TEXT: {
+            const unsigned char *text = sqlite3_column_text(statement, column);
+            return [[NSString alloc] initWithBytes:text length:(NSUInteger)sqlite3_column_bytes(statement, column) encoding:NSUTF8StringEncoding] ?: [NSNull null];
+        }
+        case SQLITE_BLOB: {
+            const void *bytes = sqlite3_column_blob(statement, column);
+            return [NSData dataWithBytes:bytes length:(NSUInteger)sqlite3_column_bytes(statement, column)];
+        }
+        default:
+            return [NSNull null];
+    }
+}
+
+@implementation SQLiteQueryUtil {
+    atomic_uint_fast64_t _statementCacheHitCount;
+    atomic_uint_fast64_t _statementCacheMissCount;
+    atomic_bool _firstQueryCompleted;
+    uint64_t _initTimestamp;
+}
 
 -(id)initWithDBPath:(NSString*)dbPath {
+    return [self initWithDBPath:dbPath configuration:nil];
+}
+
+-(id)initWithDBPath:(NSString*)dbPath configuration:(SQLiteQueryUtilConfiguration*)configuration {
     if(self = [super init]) {
         if([dbPath isKindOfClass:[NSString class]]) {
             self.dbPath = dbPath;
         }
+        if([configuration isKindOfClass:[SQLiteQueryUtilConfiguration class]]) {
+            self.configuration = configuration;
+        }
+        
+        self.readerQueue = [[NSOperationQueue alloc] init];
+        self.readerQueue.name = @"SQLiteQueryUtil.reader";
+        self.readerConnectionPoolSize = SQLiteQueryUtilDefaultReaderConnectionPoolSize;
+        _statementCacheCapacity = SQLiteQueryUtilDefaultStatementCacheCapacity;
+        atomic_init(&_statementCacheHitCount, 0);
+        atomic_init(&_statementCacheMissCount, 0);
+        atomic_init(&_firstQueryCompleted, false);
+        _initTimestamp = SQLiteQueryUtilTimestamp();
+        self.pooledConnectionsByDB = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+        self.poolLock = [[NSObject alloc] init];
+        self.idleReaderConnections = [[NSMutableArray alloc] init];
+        self.checkedOutReaderStatuses = [NSMapTable strongToStrongObjectsMapTable];
+        self.pendingReaderMemoryReleases = [NSMapTable strongToStrongObjectsMapTable];
+        self.writerLock = [[NSRecursiveLock alloc] init];
+        self.resultCache = [[SQLiteQueryResultCache alloc] init];
+        
+        // one busy handler per connection, the backoff handler replaces sqlite3_busy_timeout so it takes over the configured wait
+        self.busyRetryDeadline = self.configuration.busyTimeout > 0 ? self.configuration.busyTimeout : SQLiteQueryUtilDefaultBusyRetryDeadline;
+        self.busyRetryBaseDelay = SQLiteQueryUtilDefaultBusyRetryBaseDelay;
+        self.busyRetryMaxDelay = SQLiteQueryUtilDefaultBusyRetryMaxDelay;
+        
+        self.groupCommitMaxTransactions = SQLiteQueryUtilDefaultGroupCommitMaxTransactions;
+        self.groupCommitMaxDelay = SQLiteQueryUtilDefaultGroupCommitMaxDelay;
+        self.writerQueue = dispatch_queue_create("SQLiteQueryUtil.writer", DISPATCH_QUEUE_SERIAL);
+        self.pendingWrites = [[NSMutableArray alloc] init];
+        
+        self.migrationsByVersion = [[NSMutableDictionary alloc] init];
+        self.backfills = [[NSMutableArray alloc] init];
+        self.functionsByKey = [[NSMutableDictionary alloc] init];
+        self.walCheckpointSizeLimit = SQLiteQueryUtilDefaultWALCheckpointSizeLimit;
+        self.checkpointLock = [[NSObject alloc] init];
+        self.pendingChanges = [[SQLiteQueryChangeSet alloc] init];
+        self.committedChanges = [[SQLiteQueryChangeSet alloc] init];
+        self.maintenanceQueue = dispatch_queue_create("SQLiteQueryUtil.maintenance", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
     }
     return self;
 }
 
--(int)openDBReadOnly:(sqlite3**)db {
+-(void)dealloc {
+    if(self.memoryPressureSource) {
+        dispatch_source_cancel(self.memoryPressureSource);
+    }
+    [self closePooledConnections];
+    CFRelease(self.pooledConnectionsByDB);
+}
+
+-(SQLiteQueryConnection*)pooledConnectionWithDB:(sqlite3*)db readOnly:(BOOL)readOnly {
+    SQLiteQueryConnection *connection = [[SQLiteQueryConnection alloc] initWithDB:db readOnly:readOnly];
+    connection.statementCacheCapacity = self.statementCacheCapacity;
     
-    // db exists open it
-    return sqlite3_open_v2([self.dbPath UTF8String], db, SQLITE_OPEN_READONLY|SQLITE_OPEN_NOMUTEX, NULL);
+    if(self.busyRetryDeadline > 0) {
+        connection.busyRetryBaseDelay = self.busyRetryBaseDelay;
+        connection.busyRetryMaxDelay = self.busyRetryMaxDelay;
+        connection.busyRetryDeadline = self.busyRetryDeadline;
+        [connection installBusyHandler];
+    }
+    
+    if(!readOnly) {
+        // tables changed by the writer invalidate cached results once committed
+        sqlite3_update_hook(db, SQLiteQueryUtilUpdateHook, (__bridge void *)self);
+        sqlite3_rollback_hook(db, SQLiteQueryUtilRollbackHook, (__bridge void *)self);
+        
+        // checkpoints run when idle instead of inside a commit
+        if(self.walCheckpointIdleDelay > 0) {
+            sqlite3_wal_autocheckpoint(db, 0);
+        }
+#ifdef SQLITE_ENABLE_PREUPDATE_HOOK
+        sqlite3_preupdate_hook(db, SQLiteQueryUtilPreupdateHook, (__bridge void *)self);
+#endif
+    }
+    return connection;
 }
 
--(int)openDBReadWrite:(sqlite3**)db {
+// opendb compatible: hands out an idle pooled reader or opens a new one
+-(int)checkoutReaderDB:(sqlite3**)db {
+    SQLiteQueryConnection *connection = nil;
     
-    // db exists open it
-    return sqlite3_open_v2([self.dbPath UTF8String], db, SQLITE_OPEN_READWRITE, NULL);
+    @synchronized(self.poolLock) {
+        connection = [self.idleReaderConnections lastObject];
+        if(connection) {
+            [self.idleReaderConnections removeLastObject];
+        }
+    }
+    
+    if(connection) {
+        [self applyFunctionsToConnection:connection];
+        [self trackCheckedOutReader:connection];
+        *db = connection.db;
+        return SQLITE_OK;
+    }
+    
+    // configureOpenedDB applies the functions, only a registration racing the open is applied again
+    NSUInteger functionGeneration = [self currentFunctionGeneration];
+    int dbOpenResult = [self openDBReadOnly:db];
+    if(dbOpenResult == SQLITE_OK) {
+        connection = [self pooledConnectionWithDB:*db readOnly:YES];
+        connection.functionGeneration = functionGeneration;
+        [self applyFunctionsToConnection:connection];
+        @synchronized(self.poolLock) {
+            CFDictionarySetValue(self.pooledConnectionsByDB, *db, (__bridge const void *)connection);
+        }
+        [self trackCheckedOutReader:connection];
+    }
+    
+    // on failure *db is left for the caller to report and close via checkinDB:
+    return dbOpenResult;
 }
 
--(int)openForCreateDB:(sqlite3**)db {
-    //db does not exist create it
-    return sqlite3_open_v2([self.dbPath UTF8String], db, SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, NULL);
+// measured while the checking out thread still holds it alone, memoryStatus reports this until checkin
+-(void)trackCheckedOutReader:(SQLiteQueryConnection*)connection {
+    SQLiteQueryMemoryStatus *connectionStatus = [[SQLiteQueryMemoryStatus alloc] init];
+    [self addStatusOfDB:connection.db toMemoryStatus:connectionStatus];
+    
+    @synchronized(self.poolLock) {
+        [self.checkedOutReaderStatuses setObject:connectionStatus forKey:connection];
+    }
 }
 
--(int32_t)dbVersionWithDB:(sqlite3**)db {
-    __block int32_t version = 0;
+// opendb compatible: locks and hands out the single writer, opening it with opendb the first time
+-(int)checkoutWriterDB:(sqlite3**)db withOpenDB:(int (^)(sqlite3** db))opendb {
+    [self.writerLock lock];
     
-    NSString *query = @"PRAGMA user_version;";
+    if(self.writerConnection) {
+        ++self.writerCheckoutDepth;
+        [self applyFunctionsToConnection:self.writerConnection];
+        *db = self.writerConnection.db;
+        return SQLITE_OK;
+    }
     
-    [self queryDB:query withDB:db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
-        
-        
-    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
-        
-        version = sqlite3_column_int(queryStatement, 0);
-        
-    } onQueryCompleteCallack:^{
-        
-    }];
+    // configureOpenedDB applies the functions, only a registration racing the open is applied again
+    NSUInteger functionGeneration = [self currentFunctionGeneration];
+    int dbOpenResult = opendb(db);
+    if(dbOpenResult == SQLITE_OK) {
+        SQLiteQueryConnection *connection = [self pooledConnectionWithDB:*db readOnly:NO];
+        connection.functionGeneration = functionGeneration;
+        [self applyFunctionsToConnection:connection];
+        self.writerConnection = connection;
+        ++self.writerCheckoutDepth;
+        @synchronized(self.poolLock) {
+            CFDictionarySetValue(self.pooledConnectionsByDB, *db, (__bridge const void *)connection);
+        }
+    }
+    else {
+        [self.writerLock unlock];
+    }
     
-    return version;
+    return dbOpenResult;
 }
 
--(int32_t)dbVersion {
-    __block int32_t version = 0;
+// closedb compatible: returns a pooled connection, closes anything the pool does not own
+-(int)checkinDB:(sqlite3*)db {
+    if(db == NULL) {
+        return SQLITE_OK;
+    }
     
-    NSString *query = @"PRAGMA user_version;";
+    SQLiteQueryConnection *connection = nil;
+    @synchronized(self.poolLock) {
+        connection = (__bridge SQLiteQueryConnection *)CFDictionaryGetValue(self.pooledConnectionsByDB, db);
+    }
     
-    [self queryDB:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
-        
-        
-    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+    if(!connection) {
+        // failed open or closed pool, not ours to keep
+        return sqlite3_close(db);
+    }
+    
+    if(!connection.isReadOnly) {
+        --self.writerCheckoutDepth;
         
-        version = sqlite3_column_int(queryStatement, 0);
+        // outermost checkin, never hand an open transaction to the next writer
+        if(self.writerCheckoutDepth == 0 && sqlite3_get_autocommit(db) == 0) {
+            NSLog(@"[SQLITE] Writer checked in with an open transaction, rolling back");
+            int rollbackResponse = sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+            if (rollbackResponse != SQLITE_OK) {
+                NSLog(@"[SQLITE] Rollback Error: %d %s",rollbackResponse, sqlite3_errmsg(db));
+            }
+        }
         
-    } onQueryCompleteCallack:^{
+        // changes are committed now, readers can no longer see the old rows
+        if(self.writerCheckoutDepth == 0) {
+            // no transaction is open, writes the commit paths did not see, ie sqlite3_exec or blob writes, have committed
+            [self writerDidCommit];
+            [self deliverCommittedChanges];
+            [self scheduleIdleCheckpoint];
+        }
         
-    }];
+        [self.writerLock unlock];
+        return SQLITE_OK;
+    }
     
-    return version;
-}
-
--(BOOL)setdbVersion:(int32_t)updatedVersion withDB:(sqlite3**)db {
-    __block BOOL success = NO;
+    NSNumber *pendingMemoryRelease = nil;
+    @synchronized(self.poolLock) {
+        [self.checkedOutReaderStatuses removeObjectForKey:connection];
+        pendingMemoryRelease = [self.pendingReaderMemoryReleases objectForKey:connection];
+        [self.pendingReaderMemoryReleases removeObjectForKey:connection];
+    }
     
-    if(updatedVersion < INT32_MIN || updatedVersion > INT32_MAX) {
-        NSLog(@"[SQLITE] Invalid version args");
-        return success;
+    // reset any statement left mid step so the reader holds no read lock while idle
+    sqlite3_stmt *statement = NULL;
+    while((statement = sqlite3_next_stmt(db, statement)) != NULL) {
+        sqlite3_reset(statement);
     }
     
-    NSString *query = [NSString stringWithFormat:@"PRAGMA user_version=%d;", updatedVersion];
+    // memory was released while this reader was checked out
+    if(pendingMemoryRelease) {
+        if([pendingMemoryRelease boolValue]) {
+            [connection clearStatementCache];
+        }
+        sqlite3_db_release_memory(db);
+    }
     
-    [self writeQueryInDB:query withDB:db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
-        
-    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
-        success = YES;
-    } onQueryCompleteCallack:^{
-        
-    }];
+    BOOL keepConnection = NO;
+    @synchronized(self.poolLock) {
+        keepConnection = self.idleReaderConnections.count < self.readerConnectionPoolSize;
+        if(keepConnection) {
+            [self.idleReaderConnections addObject:connection];
+        }
+        else {
+            CFDictionaryRemoveValue(self.pooledConnectionsByDB, db);
+        }
+    }
     
-    return success;
+    return keepConnection ? SQLITE_OK : [connection close];
 }
 
--(BOOL)setdbVersion:(int32_t)updatedVersion {
-    __block BOOL success = NO;
+// writer held, called once a commit on the writer returned SQLITE_OK. cached results reading its tables are dropped
+// right away so readers never see rows older than a durable commit, its pending changes join the change feed
+-(void)writerDidCommit {
+    [self.resultCache commitChangedTables];
+    [self.resultCache commitPendingInvalidations];
     
-    if(updatedVersion < INT32_MIN || updatedVersion > INT32_MAX) {
-        NSLog(@"[SQLITE] Invalid version args");
-        return success;
+    if(self.pendingChanges.count > 0) {
+        [self.committedChanges addChangesFromChangeSet:self.pendingChanges];
+        [self.pendingChanges removeAllChanges];
+    }
+}
+
+// writer held, hands everything committed since the last delivery to changeFeedHandler
+-(void)deliverCommittedChanges {
+    void (^changeFeedHandler)(SQLiteQueryChangeSet *changeSet) = self.changeFeedHandler;
+    if(self.committedChanges.count == 0) {
+        return;
     }
     
+    SQLiteQueryChangeSet *changeSet = self.committedChanges;
+    self.committedChanges = [[SQLiteQueryChangeSet alloc] init];
     
-    NSString *query = [NSString stringWithFormat:@"PRAGMA user_version=%d;", updatedVersion];
+    if(changeFeedHandler) {
+        dispatch_async(self.changeFeedQueue ?: dispatch_get_main_queue(), ^{
+            changeFeedHandler(changeSet);
+        });
+    }
+}
+
+-(void)setWalCheckpointIdleDelay:(NSTimeInterval)walCheckpointIdleDelay {
+    _walCheckpointIdleDelay = walCheckpointIdleDelay;
     
-    [self writeQueryInDB:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
-        
-    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
-        success = YES;
-    } onQueryCompleteCallack:^{
+    // sqlite's default of 1000 pages back when scheduling is off
+    [self.writerLock lock];
+    if(self.writerConnection) {
+        sqlite3_wal_autocheckpoint(self.writerConnection.db, walCheckpointIdleDelay > 0 ? 0 : 1000);
+    }
+    [self.writerLock unlock];
+}
+
+// writer held, checkpoints once walCheckpointIdleDelay passes without another write
+-(void)scheduleIdleCheckpoint {
+    NSTimeInterval idleDelay = self.walCheckpointIdleDelay;
+    if(idleDelay <= 0) {
+        return;
+    }
+    
+    NSUInteger checkpointGeneration = ++self.checkpointGeneration;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(idleDelay * NSEC_PER_SEC)), self.maintenanceQueue, ^{
+        [self.writerLock lock];
+        BOOL writerIdle = self.checkpointGeneration == checkpointGeneration;
+        [self.writerLock unlock];
         
-    }];
+        if(writerIdle) {
+            [self runIdleCheckpoint];
+        }
+    });
+}
+
+-(void)runIdleCheckpoint {
+    void (^checkpointMetricsHandler)(SQLiteQueryCheckpointMetrics *metrics) = self.checkpointMetricsHandler;
     
-    return success;
+    // only an oversized wal is worth waiting on readers and blocking writers for, frames pinned by readers are left to the next run
+    int mode = [self walSize] > self.walCheckpointSizeLimit ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE;
+    SQLiteQueryCheckpointMetrics *metrics = [self checkpointWithMode:mode];
+    if(checkpointMetricsHandler) {
+        checkpointMetricsHandler(metrics);
+    }
 }
 
-// capture the workflow open, exc, close with error handling
--(void)openDB:(int (^)(sqlite3** db))opendb closedb:(int (^)(sqlite3*db))closedb andExecuteSQL:(NSString*)query isWriteQuery:(BOOL)isWriteQuery withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+-(unsigned long long)walSize {
+    struct stat walStat;
+    NSString *walPath = [self.dbPath stringByAppendingString:@"-wal"];
+    return stat([walPath fileSystemRepresentation], &walStat) == 0 ? (unsigned long long)walStat.st_size : 0;
+}
+
+-(SQLiteQueryCheckpointMetrics*)checkpointWithMode:(int)mode {
+    SQLiteQueryCheckpointMetrics *metrics = [[SQLiteQueryCheckpointMetrics alloc] init];
+    metrics.mode = mode;
+    metrics.walSizeBefore = [self walSize];
     
-    if(![query isKindOfClass:[NSString class]]) {
-        NSLog(@"[SQLITE] Invalid query object type");
+    uint64_t startTime = SQLiteQueryUtilTimestamp();
+    
+    // not the writer, checkpoint and writes proceed side by side
+    @synchronized(self.checkpointLock) {
+        int dbOpenResult = SQLITE_OK;
+        if(!self.checkpointDB) {
+            sqlite3 *db = NULL;
+            dbOpenResult = [self openDBReadWrite:&db];
+            if(dbOpenResult == SQLITE_OK) {
+                self.checkpointDB = db;
+            }
+            else {
+                NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+                sqlite3_close(db);
+            }
+        }
         
-        // end here, callback or not
-        if(onQueryCompleteCallack) {
-            onQueryCompleteCallack();
+        if(self.checkpointDB) {
+            int walFrameCount = 0;
+            int checkpointedFrameCount = 0;
+            metrics.resultCode = sqlite3_wal_checkpoint_v2(self.checkpointDB, NULL, mode, &walFrameCount, &checkpointedFrameCount);
+            metrics.walFrameCount = walFrameCount;
+            metrics.checkpointedFrameCount = checkpointedFrameCount;
+            
+            if(metrics.resultCode != SQLITE_OK && metrics.resultCode != SQLITE_BUSY) {
+                NSLog(@"[SQLITE] Checkpoint failed %d %s", metrics.resultCode, sqlite3_errmsg(self.checkpointDB));
+            }
+        }
+        else {
+            metrics.resultCode = dbOpenResult;
         }
+    }
+    
+    metrics.totalDuration = SQLiteQueryUtilSecondsBetween(startTime, SQLiteQueryUtilTimestamp());
+    return metrics;
+}
+
++(void)setSoftHeapLimit:(sqlite3_int64)softHeapLimit {
+    sqlite3_soft_heap_limit64(softHeapLimit);
+}
+
++(sqlite3_int64)softHeapLimit {
+    // a negative limit only reads the current one
+    return sqlite3_soft_heap_limit64(-1);
+}
+
+-(void)setReleasesMemoryOnPressure:(BOOL)releasesMemoryOnPressure {
+    if(_releasesMemoryOnPressure == releasesMemoryOnPressure) {
         return;
     }
-    if(!opendb) {
-        NSLog(@"[SQLITE] Invalid args");
-        
-        // end here, callback or not
-        if(onQueryCompleteCallack) {
-            onQueryCompleteCallack();
-        }
+    _releasesMemoryOnPressure = releasesMemoryOnPressure;
+    
+    if(self.memoryPressureSource) {
+        dispatch_source_cancel(self.memoryPressureSource);
+        self.memoryPressureSource = nil;
+    }
+    if(!releasesMemoryOnPressure) {
         return;
     }
     
-    sqlite3 *db = NULL;
-    int dbOpenResult = opendb(&db);
-    if (dbOpenResult != SQLITE_OK) {
-        
-        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
-        
-        // properly close
-        int closeResult = 0;
-        
-        bool callCloseBlock = closedb != nil;
-        if(callCloseBlock) {
-            closeResult = closedb(db);
+    dispatch_source_t memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0, DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL, self.maintenanceQueue);
+    
+    // the source is owned by self, the handler must not retain it
+    __weak SQLiteQueryUtil *weakSelf = self;
+    dispatch_source_set_event_handler(memoryPressureSource, ^{
+        SQLiteQueryUtil *strongSelf = weakSelf;
+        if(!strongSelf) {
+            return;
         }
-        else {
-            closeResult = sqlite3_close(db);
+        unsigned long pressure = dispatch_source_get_data(strongSelf.memoryPressureSource);
+        [strongSelf releaseMemoryClosingIdleConnections:(pressure & DISPATCH_MEMORYPRESSURE_CRITICAL) != 0];
+    });
+    self.memoryPressureSource = memoryPressureSource;
+    dispatch_resume(memoryPressureSource);
+}
+
+-(void)releaseMemoryClosingIdleConnections:(BOOL)closeIdleConnections {
+    [self.resultCache invalidateTables:nil];
+    
+    NSArray *idleReaders = nil;
+    @synchronized(self.poolLock) {
+        if(closeIdleConnections) {
+            idleReaders = [self.idleReaderConnections copy];
+            [self.idleReaderConnections removeAllObjects];
+            for(SQLiteQueryConnection *connection in idleReaders) {
+                CFDictionaryRemoveValue(self.pooledConnectionsByDB, connection.db);
+            }
         }
+        else {
+            // idle readers can not be checked out while the pool is locked
+            for(SQLiteQueryConnection *connection in self.idleReaderConnections) {
+                sqlite3_db_release_memory(connection.db);
+            }
+        }
+        
+        // checked out readers belong to another thread, they release theirs when checked in
+        for(SQLiteQueryConnection *connection in self.checkedOutReaderStatuses) {
+            BOOL clearsStatementCache = closeIdleConnections || [[self.pendingReaderMemoryReleases objectForKey:connection] boolValue];
+            [self.pendingReaderMemoryReleases setObject:@(clearsStatementCache) forKey:connection];
+        }
+    }
+    
+    for(SQLiteQueryConnection *connection in idleReaders) {
+        [connection close];
+    }
+    
+    if(closeIdleConnections) {
+        [self closeCheckpointDB];
+    }
+    
+    [self.writerLock lock];
+    if(self.writerConnection) {
+        if(closeIdleConnections) {
+            [self.writerConnection clearStatementCache];
+        }
+        sqlite3_db_release_memory(self.writerConnection.db);
+    }
+    [self.writerLock unlock];
+}
+
+-(SQLiteQueryMemoryStatus*)memoryStatus {
+    SQLiteQueryMemoryStatus *status = [[SQLiteQueryMemoryStatus alloc] init];
+    
+    sqlite3_int64 memoryUsed = 0;
+    sqlite3_int64 memoryHighwater = 0;
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &memoryUsed, &memoryHighwater, 0);
+    status.memoryUsed = memoryUsed;
+    status.memoryHighwater = memoryHighwater;
+    
+    // idle readers stay checked in while measured so no one else can be using them, checked out ones as of their checkout
+    @synchronized(self.poolLock) {
+        for(SQLiteQueryConnection *connection in self.idleReaderConnections) {
+            [self addStatusOfDB:connection.db toMemoryStatus:status];
+        }
+        for(SQLiteQueryMemoryStatus *connectionStatus in [self.checkedOutReaderStatuses objectEnumerator]) {
+            [self addConnectionStatus:connectionStatus toMemoryStatus:status];
+        }
+    }
+    
+    [self.writerLock lock];
+    if(self.writerConnection) {
+        [self addStatusOfDB:self.writerConnection.db toMemoryStatus:status];
+    }
+    [self.writerLock unlock];
+    
+    return status;
+}
+
+-(void)addStatusOfDB:(sqlite3*)db toMemoryStatus:(SQLiteQueryMemoryStatus*)status {
+    int current = 0;
+    int highwater = 0;
+    
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0);
+    status.pageCacheUsed += current;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_STMT_USED, &current, &highwater, 0);
+    status.statementMemoryUsed += current;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_SCHEMA_USED, &current, &highwater, 0);
+    status.schemaMemoryUsed += current;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &current, &highwater, 0);
+    status.pageCacheHitCount += current;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &current, &highwater, 0);
+    status.pageCacheMissCount += current;
+    
+    ++status.connectionCount;
+}
+
+-(void)addConnectionStatus:(SQLiteQueryMemoryStatus*)connectionStatus toMemoryStatus:(SQLiteQueryMemoryStatus*)status {
+    status.pageCacheUsed += connectionStatus.pageCacheUsed;
+    status.statementMemoryUsed += connectionStatus.statementMemoryUsed;
+    status.schemaMemoryUsed += connectionStatus.schemaMemoryUsed;
+    status.pageCacheHitCount += connectionStatus.pageCacheHitCount;
+    status.pageCacheMissCount += connectionStatus.pageCacheMissCount;
+    status.connectionCount += connectionStatus.connectionCount;
+}
+
+-(void)closeCheckpointDB {
+    @synchronized(self.checkpointLock) {
+        if(self.checkpointDB) {
+            int closeResult = sqlite3_close(self.checkpointDB);
+            if(closeResult != SQLITE_OK) {
+                NSLog(@"[SQLITE] Error failed to close db %d %s", closeResult, sqlite3_errmsg(self.checkpointDB));
+            }
+            self.checkpointDB = NULL;
+        }
+    }
+}
+
+-(void)closePooledConnections {
+    [self closeCheckpointDB];
+    
+    NSArray *idleReaders = nil;
+    @synchronized(self.poolLock) {
+        idleReaders = [self.idleReaderConnections copy];
+        [self.idleReaderConnections removeAllObjects];
+        for(SQLiteQueryConnection *connection in idleReaders) {
+            CFDictionaryRemoveValue(self.pooledConnectionsByDB, connection.db);
+        }
+    }
+    for(SQLiteQueryConnection *connection in idleReaders) {
+        [connection close];
+    }
+    
+    [self.writerLock lock];
+    SQLiteQueryConnection *writer = self.writerConnection;
+    if(writer) {
+        @synchronized(self.poolLock) {
+            CFDictionaryRemoveValue(self.pooledConnectionsByDB, writer.db);
+        }
+        self.writerConnection = nil;
+        [writer close];
+    }
+    [self.writerLock unlock];
+}
+
+-(SQLiteQueryConnection*)pooledConnectionForDB:(sqlite3*)db {
+    if(db == NULL) {
+        return nil;
+    }
+    
+    @synchronized(self.poolLock) {
+        return (__bridge SQLiteQueryConnection *)CFDictionaryGetValue(self.pooledConnectionsByDB, db);
+    }
+}
+
+-(void)setReaderConnectionPoolSize:(NSUInteger)readerConnectionPoolSize {
+    _readerConnectionPoolSize = readerConnectionPoolSize;
+    
+    // more concurrent reads than pooled readers would open and close overflow connections
+    self.readerQueue.maxConcurrentOperationCount = (NSInteger)MAX(readerConnectionPoolSize, (NSUInteger)1);
+}
+
+-(void)setStatementCacheCapacity:(NSUInteger)statementCacheCapacity {
+    _statementCacheCapacity = statementCacheCapacity;
+    
+    // idle readers can be resized now, checked out ones and the writer pick it up on their next prepare
+    @synchronized(self.poolLock) {
+        for(SQLiteQueryConnection *connection in self.idleReaderConnections) {
+            connection.statementCacheCapacity = statementCacheCapacity;
+        }
+    }
+}
+
+-(uint64_t)statementCacheHitCount {
+    return atomic_load(&_statementCacheHitCount);
+}
+
+-(uint64_t)statementCacheMissCount {
+    return atomic_load(&_statementCacheMissCount);
+}
+
+// prepare through the pooled connection's statement cache, plain prepare for caller owned connections
+-(int)prepareStatement:(sqlite3_stmt**)statement forQuery:(NSString*)query withDB:(sqlite3*)db {
+    SQLiteQueryConnection *connection = [self pooledConnectionForDB:db];
+    if(!connection) {
+        return sqlite3_prepare_v2(db, [query UTF8String], -1, statement, NULL);
+    }
+    
+    if(connection.statementCacheCapacity != self.statementCacheCapacity) {
+        connection.statementCacheCapacity = self.statementCacheCapacity;
+    }
+    
+    BOOL cacheHit = NO;
+    int prepareResponse = [connection prepareStatement:statement forQuery:query cacheHit:&cacheHit];
+    atomic_fetch_add(cacheHit ? &_statementCacheHitCount : &_statementCacheMissCount, 1);
+    return prepareResponse;
+}
+
+// counterpart of prepareStatement:forQuery:withDB:
+-(int)finalizeStatement:(sqlite3_stmt*)statement forQuery:(NSString*)query withDB:(sqlite3*)db {
+    SQLiteQueryConnection *connection = [self pooledConnectionForDB:db];
+    if(!connection) {
+        return sqlite3_finalize(statement);
+    }
+    return [connection releaseStatement:statement forQuery:query];
+}
+
+-(int)openDBReadOnly:(sqlite3**)db {
+    
+    // db exists open it
+    int dbOpenResult = SQLITE_OK;
+    if(self.configuration.immutable) {
+        // no locks and no change checks, the file must never be written
+        NSString *path = [self.dbPath stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet URLPathAllowedCharacterSet]];
+        NSString *uri = [NSString stringWithFormat:@"file:%@?immutable=1", path];
+        dbOpenResult = sqlite3_open_v2([uri UTF8String], db, SQLITE_OPEN_READONLY|SQLITE_OPEN_NOMUTEX|SQLITE_OPEN_URI, NULL);
+    }
+    else {
+        dbOpenResult = sqlite3_open_v2([self.dbPath UTF8String], db, SQLITE_OPEN_READONLY|SQLITE_OPEN_NOMUTEX, NULL);
+    }
+    [self configureOpenedDB:*db openResult:dbOpenResult readOnly:YES];
+    return dbOpenResult;
+}
+
+-(int)openDBReadWrite:(sqlite3**)db {
+    
+    // db exists open it
+    int dbOpenResult = sqlite3_open_v2([self.dbPath UTF8String], db, SQLITE_OPEN_READWRITE, NULL);
+    [self configureOpenedDB:*db openResult:dbOpenResult readOnly:NO];
+    return dbOpenResult;
+}
+
+-(int)openForCreateDB:(sqlite3**)db {
+    //db does not exist create it
+    int dbOpenResult = sqlite3_open_v2([self.dbPath UTF8String], db, SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, NULL);
+    [self configureOpenedDB:*db openResult:dbOpenResult readOnly:NO];
+    return dbOpenResult;
+}
+
+// apply the PRAGMA profile once per connection, a failed PRAGMA is logged but does not fail the open
+-(void)configureOpenedDB:(sqlite3*)db openResult:(int)dbOpenResult readOnly:(BOOL)readOnly {
+    if(dbOpenResult != SQLITE_OK) {
+        return;
+    }
+    
+    // every connection gets the functions here, pooled ones again at checkout only if registrations changed since
+    [self applyFunctionsToDB:db];
+    
+    if(!self.configuration) {
+        return;
+    }
+    [self.configuration applyToDB:db readOnly:readOnly];
+}
+
+-(int32_t)dbVersionWithDB:(sqlite3**)db {
+    __block int32_t version = 0;
+    
+    NSString *query = @"PRAGMA user_version;";
+    
+    [self queryDB:query withDB:db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        
+        
+    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        
+        version = sqlite3_column_int(queryStatement, 0);
+        
+    } onQueryCompleteCallack:^{
+        
+    }];
+    
+    return version;
+}
+
+-(int32_t)dbVersion {
+    __block int32_t version = 0;
+    
+    NSString *query = @"PRAGMA user_version;";
+    
+    [self queryDB:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        
+        
+    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        
+        version = sqlite3_column_int(queryStatement, 0);
+        
+    } onQueryCompleteCallack:^{
+        
+    }];
+    
+    return version;
+}
+
+-(BOOL)setdbVersion:(int32_t)updatedVersion withDB:(sqlite3**)db {
+    __block BOOL success = NO;
+    
+    if(updatedVersion < INT32_MIN || updatedVersion > INT32_MAX) {
+        NSLog(@"[SQLITE] Invalid version args");
+        return success;
+    }
+    
+    NSString *query = [NSString stringWithFormat:@"PRAGMA user_version=%d;", updatedVersion];
+    
+    [self writeQueryInDB:query withDB:db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        
+    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        success = YES;
+    } onQueryCompleteCallack:^{
+        
+    }];
+    
+    return success;
+}
+
+-(BOOL)setdbVersion:(int32_t)updatedVersion {
+    __block BOOL success = NO;
+    
+    if(updatedVersion < INT32_MIN || updatedVersion > INT32_MAX) {
+        NSLog(@"[SQLITE] Invalid version args");
+        return success;
+    }
+    
+    
+    NSString *query = [NSString stringWithFormat:@"PRAGMA user_version=%d;", updatedVersion];
+    
+    [self writeQueryInDB:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        
+    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        success = YES;
+    } onQueryCompleteCallack:^{
+        
+    }];
+    
+    return success;
+}
+
+// capture the workflow open, exc, close with error handling
+// returns the last sqlite3_step result, the open or prepare result when those failed
+-(int)openDB:(int (^)(sqlite3** db))opendb closedb:(int (^)(sqlite3*db))closedb andExecuteSQL:(NSString*)query isWriteQuery:(BOOL)isWriteQuery withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    if(![query isKindOfClass:[NSString class]]) {
+        NSLog(@"[SQLITE] Invalid query object type");
+        
+        // end here, callback or not
+        if(onQueryCompleteCallack) {
+            onQueryCompleteCallack();
+        }
+        return SQLITE_MISUSE;
+    }
+    if(!opendb) {
+        NSLog(@"[SQLITE] Invalid args");
+        
+        // end here, callback or not
+        if(onQueryCompleteCallack) {
+            onQueryCompleteCallack();
+        }
+        return SQLITE_MISUSE;
+    }
+    
+    // measurements only when someone is listening
+    void (^statementMetricsHandler)(SQLiteQueryStatementMetrics *metrics) = self.statementMetricsHandler;
+    SQLiteQueryStatementMetrics *metrics = nil;
+    if(statementMetricsHandler) {
+        metrics = [[SQLiteQueryStatementMetrics alloc] init];
+        metrics.query = query;
+        metrics.isWriteQuery = isWriteQuery;
+    }
+    uint64_t startTime = metrics ? SQLiteQueryUtilTimestamp() : 0;
+    
+    os_signpost_id_t signpostID = 0;
+    if(self.signpostsEnabled) {
+        if (@available(iOS 12.0, macOS 10.14, tvOS 12.0, watchOS 5.0, *)) {
+            signpostID = os_signpost_id_generate(SQLiteQueryUtilSignpostLog());
+            os_signpost_interval_begin(SQLiteQueryUtilSignpostLog(), signpostID, "SQLiteQuery", "%{public}s", [query UTF8String]);
+        }
+    }
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = opendb(&db);
+    uint64_t openedTime = metrics ? SQLiteQueryUtilTimestamp() : 0;
+    NSUInteger busyRetryCountAtOpen = metrics && dbOpenResult == SQLITE_OK ? [self pooledConnectionForDB:db].busyRetryCount : 0;
+    if (dbOpenResult != SQLITE_OK) {
+        
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        
+        // properly close
+        int closeResult = 0;
+        
+        bool callCloseBlock = closedb != nil;
+        if(callCloseBlock) {
+            closeResult = closedb(db);
+        }
+        else {
+            closeResult = sqlite3_close(db);
+        }
+        
+        if(closeResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Error failed to close db %d %s", closeResult, sqlite3_errmsg(db));
+        }
+        
+        if(signpostID != 0) {
+            if (@available(iOS 12.0, macOS 10.14, tvOS 12.0, watchOS 5.0, *)) {
+                os_signpost_interval_end(SQLiteQueryUtilSignpostLog(), signpostID, "SQLiteQuery", "open failed %d", dbOpenResult);
+            }
+        }
+        
+        if(metrics) {
+            metrics.resultCode = dbOpenResult;
+            metrics.openDuration = SQLiteQueryUtilSecondsBetween(startTime, openedTime);
+            metrics.totalDuration = metrics.openDuration;
+            statementMetricsHandler(metrics);
+        }
+        
+        // end here, callback or not
+        if(onQueryCompleteCallack) {
+            onQueryCompleteCallack();
+        }
+        return dbOpenResult;
+    }
+    
+    /*
+     int enableExtendedResultCode = sqlite3_extended_result_codes(db, 1);
+     if(enableExtendedResultCode != 0) {
+     NSLog(@"[SQLITE] Error Failed to enable extended result codes: %d", enableExtendedResultCode);
+     }
+     */
+    
+    sqlite3_stmt *statement = NULL;
+    int prepareResponse = [self prepareStatement:&statement forQuery:query withDB:db];
+    uint64_t preparedTime = metrics ? SQLiteQueryUtilTimestamp() : 0;
+    int rowResult = prepareResponse;
+    NSUInteger currentRow = 0;
+    
+    if (prepareResponse != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error preparing query %s", sqlite3_errmsg(db));
+    } else {
+        
+        if(bindParamsCallback) {
+            bindParamsCallback(statement);
+        }
+        
+        rowResult = sqlite3_step(statement);
+        while(rowResult == SQLITE_ROW) {
+            if(onNextRowCallback) {
+                onNextRowCallback(statement, currentRow);
+            }
+            ++currentRow;
+            
+            rowResult = sqlite3_step(statement);
+        }
+        
+        if(rowResult == SQLITE_DONE) {
+            // for insert execute onNextRowCallback once for caller to retrieve row id via
+            // execute sqlite3_last_insert_rowid
+            if(isWriteQuery && currentRow == 0 && onNextRowCallback) {
+                onNextRowCallback(statement, currentRow);
+            }
+        }
+        else {
+            NSLog(@"[SQLITE] Error unexpected last row result %d %s", rowResult, sqlite3_errmsg(db));
+        }
+    }
+    
+    int finalizeResult = [self finalizeStatement:statement forQuery:query withDB:db];
+    if(finalizeResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to finalize prepare statement %d", finalizeResult);
+    }
+    else {
+        statement = nil;
+    }
+    
+    // a write outside a transaction, or a COMMIT, committed once the statement finished
+    if(isWriteQuery && rowResult == SQLITE_DONE && sqlite3_get_autocommit(db)) {
+        SQLiteQueryConnection *connection = [self pooledConnectionForDB:db];
+        if(connection && !connection.isReadOnly) {
+            [self writerDidCommit];
+        }
+    }
+    
+    if(metrics) {
+        uint64_t endTime = SQLiteQueryUtilTimestamp();
+        metrics.openDuration = SQLiteQueryUtilSecondsBetween(startTime, openedTime);
+        metrics.prepareDuration = SQLiteQueryUtilSecondsBetween(openedTime, preparedTime);
+        metrics.totalDuration = SQLiteQueryUtilSecondsBetween(startTime, endTime);
+        metrics.rowCount = currentRow;
+        metrics.stepCount = prepareResponse == SQLITE_OK ? currentRow + 1 : 0;
+        metrics.resultCode = rowResult;
+        metrics.busyRetryCount = [self pooledConnectionForDB:db].busyRetryCount - busyRetryCountAtOpen;
+        
+        // plan the slow query on the same connection before it is checked in
+        if(self.slowQueryThreshold > 0 && metrics.totalDuration >= self.slowQueryThreshold) {
+            metrics.queryPlan = [self queryPlanForQuery:query withDB:db];
+        }
+    }
+    
+    int closeResult = 0;
+    
+    bool callCloseBlock = closedb != nil;
+    if(callCloseBlock) {
+        closeResult = closedb(db);
+    }
+    else {
+        closeResult = sqlite3_close(db);
+    }
+    
+    if(closeResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to close db %d", closeResult);
+    }
+    
+    if(signpostID != 0) {
+        if (@available(iOS 12.0, macOS 10.14, tvOS 12.0, watchOS 5.0, *)) {
+            os_signpost_interval_end(SQLiteQueryUtilSignpostLog(), signpostID, "SQLiteQuery", "rows %lu result %d", (unsigned long)currentRow, rowResult);
+        }
+    }
+    
+    if(rowResult == SQLITE_DONE && !atomic_exchange(&_firstQueryCompleted, true)) {
+        _timeToFirstQuery = SQLiteQueryUtilSecondsBetween(_initTimestamp, SQLiteQueryUtilTimestamp());
+    }
+    
+    if(metrics) {
+        statementMetricsHandler(metrics);
+    }
+    
+    if(onQueryCompleteCallack) {
+        onQueryCompleteCallack();
+    }
+    
+    return rowResult;
+}
+
+// EXPLAIN QUERY PLAN detail lines for query, params are left unbound
+-(NSString*)queryPlanForQuery:(NSString*)query withDB:(sqlite3*)db {
+    NSString *explainQuery = [@"EXPLAIN QUERY PLAN " stringByAppendingString:query];
+    
+    sqlite3_stmt *statement = NULL;
+    if(sqlite3_prepare_v2(db, [explainQuery UTF8String], -1, &statement, NULL) != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error preparing query %s", sqlite3_errmsg(db));
+        sqlite3_finalize(statement);
+        return nil;
+    }
+    
+    NSMutableArray *details = [[NSMutableArray alloc] init];
+    int detailColumn = sqlite3_column_count(statement) - 1;
+    while(sqlite3_step(statement) == SQLITE_ROW) {
+        const unsigned char *detail = sqlite3_column_text(statement, detailColumn);
+        if(detail != NULL) {
+            [details addObject:[[NSString alloc] initWithUTF8String:(const char *)detail]];
+        }
+    }
+    sqlite3_finalize(statement);
+    
+    return [details componentsJoinedByString:@"\n"];
+}
+
+-(void)queryDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    [self openDB:^int(sqlite3 **db) {
+        
+        return [self checkoutReaderDB:db];
+        
+    } closedb:^int(sqlite3 *db) {
+        
+        return [self checkinDB:db];
+        
+    } andExecuteSQL:query isWriteQuery:NO withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+}
+
+-(void)queryDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback completionQueue:(dispatch_queue_t)completionQueue onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    
+    [self.readerQueue addOperationWithBlock:^{
+        
+        [self queryDB:query withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:nil];
+        
+        if(onQueryCompleteCallack) {
+            dispatch_async(callbackQueue, onQueryCompleteCallack);
+        }
+    }];
+}
+
+-(void)queryDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback cancellationToken:(SQLiteQueryCancellationToken*)cancellationToken timeout:(NSTimeInterval)timeout completionQueue:(dispatch_queue_t)completionQueue onQueryCompleteCallack:(void(^)(BOOL interrupted))onQueryCompleteCallack {
+    
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    
+    [self.readerQueue addOperationWithBlock:^{
+        
+        // lives on this stack for as long as the synchronous query below
+        SQLiteQueryUtilProgressContext progressContext;
+        progressContext.cancellationToken = cancellationToken;
+        progressContext.startTime = SQLiteQueryUtilTimestamp();
+        progressContext.timeout = timeout;
+        SQLiteQueryUtilProgressContext *progressContextRef = &progressContext;
+        
+        // a query cancelled before it started is skipped and reported as interrupted
+        int lastStepResult = SQLITE_INTERRUPT;
+        if(!cancellationToken.isCancelled) {
+            lastStepResult = [self openDB:^int(sqlite3 **db) {
+                
+                int dbOpenResult = [self checkoutReaderDB:db];
+                if(dbOpenResult == SQLITE_OK) {
+                    sqlite3_progress_handler(*db, SQLiteQueryUtilProgressHandlerInterval, SQLiteQueryUtilProgressHandler, progressContextRef);
+                    [cancellationToken attachDB:*db];
+                }
+                return dbOpenResult;
+                
+            } closedb:^int(sqlite3 *db) {
+                
+                if(db != NULL) {
+                    [cancellationToken detachDB:db];
+                    sqlite3_progress_handler(db, 0, NULL, NULL);
+                }
+                return [self checkinDB:db];
+                
+            } andExecuteSQL:query isWriteQuery:NO withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:nil];
+        }
+        
+        // a cancel or timeout landing after the last step did not stop anything
+        BOOL interrupted = (lastStepResult & 0xff) == SQLITE_INTERRUPT;
+        if(onQueryCompleteCallack) {
+            dispatch_async(callbackQueue, ^{
+                onQueryCompleteCallack(interrupted);
+            });
+        }
+    }];
+}
+
+-(void)performReadOperationsInParallel:(NSArray*)readOperations completionQueue:(dispatch_queue_t)completionQueue onReadsComplete:(void (^)(NSArray *results))onReadsComplete {
+    
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    dispatch_group_t readGroup = dispatch_group_create();
+    
+    NSMutableArray *results = [[NSMutableArray alloc] initWithCapacity:readOperations.count];
+    for(NSUInteger i = 0; i < readOperations.count; ++i) {
+        [results addObject:[NSNull null]];
+    }
+    
+    [readOperations enumerateObjectsUsingBlock:^(id readOperationObject, NSUInteger readIndex, BOOL *stop) {
+        SQLiteQueryUtilReadOperation readOperation = readOperationObject;
+        
+        dispatch_group_enter(readGroup);
+        [self.readerQueue addOperationWithBlock:^{
+            
+            sqlite3 *db = NULL;
+            int dbOpenResult = [self checkoutReaderDB:&db];
+            
+            id result = nil;
+            if(dbOpenResult == SQLITE_OK) {
+                result = readOperation(db);
+            }
+            else {
+                NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+            }
+            
+            [self checkinDB:db];
+            
+            if(result) {
+                @synchronized(results) {
+                    [results replaceObjectAtIndex:readIndex withObject:result];
+                }
+            }
+            dispatch_group_leave(readGroup);
+        }];
+    }];
+    
+    dispatch_group_notify(readGroup, callbackQueue, ^{
+        if(onReadsComplete) {
+            onReadsComplete([results copy]);
+        }
+    });
+}
+
+-(BOOL)performReadSession:(void (^)(sqlite3 *db))session {
+    return [self performReadSessionOnSnapshot:nil capturesSnapshot:NO session:^(sqlite3 *db, SQLiteQueryReadSnapshot *snapshot) {
+        if(session) {
+            session(db);
+        }
+    }];
+}
+
+-(BOOL)performReadSessionOnSnapshot:(SQLiteQueryReadSnapshot*)snapshot session:(void (^)(sqlite3 *db, SQLiteQueryReadSnapshot *snapshot))session {
+    return [self performReadSessionOnSnapshot:snapshot capturesSnapshot:snapshot == nil session:session];
+}
+
+-(BOOL)performReadSessionOnSnapshot:(SQLiteQueryReadSnapshot*)snapshot capturesSnapshot:(BOOL)capturesSnapshot session:(void (^)(sqlite3 *db, SQLiteQueryReadSnapshot *snapshot))session {
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutReaderDB:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return NO;
+    }
+    
+    BOOL sessionStarted = [self readSessionOnDB:db snapshot:snapshot capturesSnapshot:capturesSnapshot session:session];
+    
+    [self checkinDB:db];
+    
+    return sessionStarted;
+}
+
+// read transaction on a checked out reader, the caller checks it back in
+-(BOOL)readSessionOnDB:(sqlite3*)db snapshot:(SQLiteQueryReadSnapshot*)snapshot capturesSnapshot:(BOOL)capturesSnapshot session:(void (^)(sqlite3 *db, SQLiteQueryReadSnapshot *snapshot))session {
+    
+    int beginResponse = sqlite3_exec(db, "BEGIN DEFERRED TRANSACTION", 0, 0, 0);
+    if(beginResponse != SQLITE_OK) {
+        NSLog(@"[SQLITE] Begin Transaction Error: %d %s",beginResponse, sqlite3_errmsg(db));
+        return NO;
+    }
+    
+    BOOL sessionStarted = YES;
+    SQLiteQueryReadSnapshot *sessionSnapshot = snapshot;
+    if(snapshot) {
+        // must happen before the transaction reads anything
+        int snapshotResponse = [snapshot openOnDB:db];
+        sessionStarted = snapshotResponse == SQLITE_OK;
+        if(!sessionStarted) {
+            NSLog(@"[SQLITE] Open Snapshot Error: %d %s",snapshotResponse, sqlite3_errmsg(db));
+        }
+    }
+    else if(capturesSnapshot) {
+        // a deferred transaction takes its snapshot at the first read
+        int readResponse = sqlite3_exec(db, "SELECT 1 FROM sqlite_master LIMIT 1", 0, 0, 0);
+        sessionStarted = readResponse == SQLITE_OK;
+        if(!sessionStarted) {
+            NSLog(@"[SQLITE] Read Transaction Error: %d %s",readResponse, sqlite3_errmsg(db));
+        }
+        else {
+            sessionSnapshot = [[SQLiteQueryReadSnapshot alloc] initWithDB:db];
+        }
+    }
+    
+    if(sessionStarted && session) {
+        session(db, sessionSnapshot);
+    }
+    
+    // ends the read transaction, nothing was written
+    int commitResponse = sqlite3_exec(db, "COMMIT TRANSACTION", 0, 0, 0);
+    if(commitResponse != SQLITE_OK) {
+        NSLog(@"[SQLITE] Commit Transaction Error: %d %s",commitResponse, sqlite3_errmsg(db));
+    }
+    
+    return sessionStarted;
+}
+
+// an idle pooled reader or NULL, never opens one so work sharing a slot stays within readerConnectionPoolSize
+-(sqlite3*)checkoutIdleReaderDB {
+    SQLiteQueryConnection *connection = nil;
+    
+    @synchronized(self.poolLock) {
+        connection = [self.idleReaderConnections lastObject];
+        if(connection) {
+            [self.idleReaderConnections removeLastObject];
+        }
+    }
+    
+    if(!connection) {
+        return NULL;
+    }
+    [self applyFunctionsToConnection:connection];
+    [self trackCheckedOutReader:connection];
+    return connection.db;
+}
+
+-(void)performConsistentReadOperationsInParallel:(NSArray*)readOperations completionQueue:(dispatch_queue_t)completionQueue onReadsComplete:(void (^)(NSArray *results, SQLiteQueryConsistentReadMode mode))onReadsComplete {
+    
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    NSUInteger readCount = readOperations.count;
+    
+    NSMutableArray *results = [[NSMutableArray alloc] initWithCapacity:readCount];
+    for(NSUInteger i = 0; i < readCount; ++i) {
+        [results addObject:[NSNull null]];
+    }
+    
+    void (^storeResult)(id result, NSUInteger readIndex) = ^(id result, NSUInteger readIndex) {
+        if(result) {
+            @synchronized(results) {
+                [results replaceObjectAtIndex:readIndex withObject:result];
+            }
+        }
+    };
+    
+    // every session pulls the next read until none is left, a session that could not open the snapshot pulls none
+    __block NSUInteger nextReadIndex = 0;
+    NSUInteger (^claimRead)(void) = ^NSUInteger {
+        @synchronized(results) {
+            return nextReadIndex < readCount ? nextReadIndex++ : NSNotFound;
+        }
+    };
+    
+    // the capturing session takes one of the reader queue's slots like any other read
+    [self.readerQueue addOperationWithBlock:^{
+        
+        __block SQLiteQueryConsistentReadMode mode = SQLiteQueryConsistentReadModeFailed;
+        BOOL sessionStarted = [self performReadSessionOnSnapshot:nil session:^(sqlite3 *db, SQLiteQueryReadSnapshot *snapshot) {
+            
+            __block NSUInteger sharedReadCount = 0;
+            __block BOOL snapshotFailed = NO;
+            dispatch_group_t readGroup = dispatch_group_create();
+            
+            // only readers already idle in the pool join in, none is opened past readerConnectionPoolSize
+            for(NSUInteger helperIndex = 1; snapshot && helperIndex < readCount; ++helperIndex) {
+                sqlite3 *helperDB = [self checkoutIdleReaderDB];
+                if(!helperDB) {
+                    break;
+                }
+                
+                dispatch_group_async(readGroup, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+                    __block NSUInteger helperReadCount = 0;
+                    BOOL snapshotOpened = [self readSessionOnDB:helperDB snapshot:snapshot capturesSnapshot:NO session:^(sqlite3 *snapshotDB, SQLiteQueryReadSnapshot *sharedSnapshot) {
+                        for(NSUInteger readIndex = claimRead(); readIndex != NSNotFound; readIndex = claimRead()) {
+                            SQLiteQueryUtilReadOperation readOperation = readOperations[readIndex];
+                            storeResult(readOperation(snapshotDB), readIndex);
+                            ++helperReadCount;
+                        }
+                    }];
+                    [self checkinDB:helperDB];
+                    
+                    @synchronized(results) {
+                        sharedReadCount += helperReadCount;
+                        snapshotFailed |= !snapshotOpened;
+                    }
+                });
+            }
+            
+            // the capturing connection reads too, and picks up whatever a reader that could not open the snapshot left
+            for(NSUInteger readIndex = claimRead(); readIndex != NSNotFound; readIndex = claimRead()) {
+                SQLiteQueryUtilReadOperation readOperation = readOperations[readIndex];
+                storeResult(readOperation(db), readIndex);
+            }
+            
+            // keeps the snapshot's read transaction open until every session opened it
+            dispatch_group_wait(readGroup, DISPATCH_TIME_FOREVER);
+            
+            // a single read needs no other connection to count as parallel
+            BOOL snapshotShared = snapshot && !snapshotFailed && (sharedReadCount > 0 || readCount < 2);
+            mode = snapshotShared ? SQLiteQueryConsistentReadModeParallel : SQLiteQueryConsistentReadModeSerialized;
+        }];
+        
+        if(!sessionStarted) {
+            NSLog(@"[SQLITE] Error consistent read session failed to start, no read ran");
+        }
+        
+        dispatch_async(callbackQueue, ^{
+            if(onReadsComplete) {
+                onReadsComplete([results copy], mode);
+            }
+        });
+    }];
+}
+
+-(void)queryDB:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    [self openDB:^int(sqlite3 **db) {
+        
+        *(db) = *dbToUse;
+        return SQLITE_OK;
+        
+    } closedb:^int(sqlite3 *db) {
+        
+        // if db is passed caller must close
+        return SQLITE_OK;
+        
+    } andExecuteSQL:query isWriteQuery:NO withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+}
+
+-(void)writeQueryInDB:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    [self openDB:^int(sqlite3 **db) {
+        
+        *(db) = *dbToUse;
+        return SQLITE_OK;
+        
+    } closedb:^int(sqlite3 *db) {
+        
+        // if db is passed caller must close
+        return SQLITE_OK;
+        
+    } andExecuteSQL:query isWriteQuery:YES withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+}
+
+-(void)writeQueryInDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    [self openDB:^int(sqlite3 **db) {
+        
+        return [self checkoutWriterDB:db withOpenDB:^int(sqlite3 **writerDB) {
+            return [self openDBReadWrite:writerDB];
+        }];
+        
+    } closedb:^int(sqlite3 *db) {
+        
+        return [self checkinDB:db];
+        
+    } andExecuteSQL:query isWriteQuery:YES withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+}
+
+-(void)queryDB:(NSString*)query withParams:(id)params onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    [self queryDB:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        [self bindParams:params toStatement:queryStatement];
+    } onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+}
+
+-(void)writeQueryInDB:(NSString*)query withParams:(id)params onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    [self writeQueryInDB:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        [self bindParams:params toStatement:queryStatement];
+    } onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+}
+
+-(void)queryDB:(NSString*)query withBindValues:(const SQLiteQueryBindValue*)values count:(int)count onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    [self queryDB:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        [self bindValues:values count:count toStatement:queryStatement];
+    } onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+}
+
+-(void)writeQueryInDB:(NSString*)query withBindValues:(const SQLiteQueryBindValue*)values count:(int)count onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    [self writeQueryInDB:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        [self bindValues:values count:count toStatement:queryStatement];
+    } onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+}
+
+-(void)bindParams:(id)params toStatement:(sqlite3_stmt*)statement {
+    int bindResult = SQLiteQueryBindParams(statement, params);
+    if(bindResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to bind params %d %s", bindResult, sqlite3_errstr(bindResult));
+    }
+}
+
+-(void)bindValues:(const SQLiteQueryBindValue*)values count:(int)count toStatement:(sqlite3_stmt*)statement {
+    int bindResult = SQLiteQueryBindTaggedValues(statement, values, count);
+    if(bindResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to bind values %d %s", bindResult, sqlite3_errstr(bindResult));
+    }
+}
+
+-(NSUInteger)queryDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback rowLayout:(SQLiteQueryRowLayout*)rowLayout intoRows:(void*)rows rowSize:(size_t)rowSize maxRows:(NSUInteger)maxRows {
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutReaderDB:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return 0;
+    }
+    
+    NSUInteger rowCount = [self queryDB:query withDB:&db withBindParamsCallback:bindParamsCallback rowLayout:rowLayout intoRows:rows rowSize:rowSize maxRows:maxRows];
+    
+    [self checkinDB:db];
+    return rowCount;
+}
+
+-(NSUInteger)queryDB:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback rowLayout:(SQLiteQueryRowLayout*)rowLayout intoRows:(void*)rows rowSize:(size_t)rowSize maxRows:(NSUInteger)maxRows {
+    if(!(rowLayout && rows != NULL && rowSize > 0 && dbToUse != NULL && *dbToUse != NULL)) {
+        NSLog(@"[SQLITE] Invalid args");
+        return 0;
+    }
+    if(rowLayout.hasViewColumns) {
+        NSLog(@"[SQLITE] Invalid row layout, text and blob views are only valid with a cursor");
+        return 0;
+    }
+    
+    SQLiteQueryCursor *cursor = [self cursorForQuery:query withDB:dbToUse withBindParamsCallback:bindParamsCallback];
+    if(!cursor) {
+        return 0;
+    }
+    
+    // resolve the layout once so the step loop sends no messages
+    const SQLiteQueryColumnBinding *bindings = rowLayout.bindings;
+    NSUInteger bindingCount = rowLayout.bindingCount;
+    sqlite3_stmt *statement = cursor.statement;
+    char *nextRow = (char *)rows;
+    
+    NSUInteger rowCount = 0;
+    while(rowCount < maxRows) {
+        int rowResult = sqlite3_step(statement);
+        if(rowResult != SQLITE_ROW) {
+            if(rowResult != SQLITE_DONE) {
+                NSLog(@"[SQLITE] Error unexpected last row result %d %s", rowResult, sqlite3_errmsg(*dbToUse));
+            }
+            break;
+        }
+        
+        SQLiteQueryDecodeRow(bindings, bindingCount, statement, nextRow);
+        nextRow += rowSize;
+        ++rowCount;
+    }
+    
+    [cursor close];
+    return rowCount;
+}
+
+-(void)setResultCacheCapacity:(NSUInteger)resultCacheCapacity {
+    self.resultCache.capacity = resultCacheCapacity;
+}
+
+-(NSUInteger)resultCacheCapacity {
+    return self.resultCache.capacity;
+}
+
+-(NSUInteger)resultCacheHitCount {
+    return self.resultCache.hitCount;
+}
+
+-(NSUInteger)resultCacheMissCount {
+    return self.resultCache.missCount;
+}
+
+-(void)invalidateResultCacheForTables:(NSSet*)tables {
+    [self.resultCache invalidateTables:tables];
+}
+
+-(NSArray*)cachedRowsForQuery:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback {
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutReaderDB:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return nil;
+    }
+    
+    BOOL useCache = self.resultCache.capacity > 0;
+    NSSet *tables = useCache ? [self.resultCache tablesReadByQuery:query withDB:db] : nil;
+    
+    SQLiteQueryCursor *cursor = [self cursorForQuery:query withDB:&db withBindParamsCallback:bindParamsCallback];
+    if(!cursor) {
+        [self checkinDB:db];
+        return nil;
+    }
+    
+    // the bound values are part of the key
+    NSString *key = nil;
+    if(useCache && tables) {
+        char *expandedSQL = sqlite3_expanded_sql(cursor.statement);
+        if(expandedSQL != NULL) {
+            key = [NSString stringWithUTF8String:expandedSQL];
+            sqlite3_free(expandedSQL);
+        }
+    }
+    
+    NSArray *cachedRows = key ? [self.resultCache rowsForKey:key] : nil;
+    if(cachedRows) {
+        [cursor close];
+        [self checkinDB:db];
+        return cachedRows;
+    }
+    
+    uint64_t generation = key ? [self.resultCache generationForTables:tables] : 0;
+    
+    NSMutableArray *rows = [[NSMutableArray alloc] init];
+    int columnCount = sqlite3_column_count(cursor.statement);
+    while([cursor next]) {
+        NSMutableArray *row = [[NSMutableArray alloc] initWithCapacity:(NSUInteger)columnCount];
+        for(int column = 0; column < columnCount; ++column) {
+            [row addObject:SQLiteQueryUtilColumnValue(cursor.statement, column)];
+        }
+        [rows addObject:row];
+    }
+    
+    BOOL querySucceeded = cursor.lastStepResult == SQLITE_DONE;
+    [cursor close];
+    [self checkinDB:db];
+    
+    if(!querySucceeded) {
+        return nil;
+    }
+    
+    if(key) {
+        [self.resultCache setRows:rows forKey:key tables:tables generation:generation];
+    }
+    return rows;
+}
+
+-(SQLiteQueryColumnarResult*)columnarResultForQuery:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback columnTypes:(const SQLiteQueryColumnType*)columnTypes columnCount:(NSUInteger)columnCount {
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutReaderDB:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return nil;
+    }
+    
+    SQLiteQueryColumnarResult *result = [self columnarResultForQuery:query withDB:&db withBindParamsCallback:bindParamsCallback columnTypes:columnTypes columnCount:columnCount];
+    [self checkinDB:db];
+    return result;
+}
+
+-(SQLiteQueryColumnarResult*)columnarResultForQuery:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback columnTypes:(const SQLiteQueryColumnType*)columnTypes columnCount:(NSUInteger)columnCount {
+    
+    SQLiteQueryCursor *cursor = [self cursorForQuery:query withDB:dbToUse withBindParamsCallback:bindParamsCallback];
+    if(!cursor) {
+        return nil;
+    }
+    
+    if(columnCount > (NSUInteger)sqlite3_column_count(cursor.statement)) {
+        NSLog(@"[SQLITE] Invalid args, %lu column types for %d columns", (unsigned long)columnCount, sqlite3_column_count(cursor.statement));
+        [cursor close];
+        return nil;
+    }
+    
+    SQLiteQueryColumnarResult *result = [[SQLiteQueryColumnarResult alloc] initWithColumnTypes:columnTypes columnCount:columnCount];
+    while([cursor next]) {
+        [result appendRowFromStatement:cursor.statement];
+    }
+    
+    return cursor.lastStepResult == SQLITE_DONE ? result : nil;
+}
+
+-(NSArray*)cachedRowsForQuery:(NSString*)query withParams:(id)params {
+    return [self cachedRowsForQuery:query withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        [self bindParams:params toStatement:queryStatement];
+    }];
+}
+
+-(SQLiteQueryCursor*)cursorForQuery:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback {
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutReaderDB:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return nil;
+    }
+    
+    SQLiteQueryCursor *cursor = [self cursorForQuery:query onDB:db withBindParamsCallback:bindParamsCallback onClose:^{
+        [self checkinDB:db];
+    }];
+    
+    if(!cursor) {
+        [self checkinDB:db];
+    }
+    return cursor;
+}
+
+-(SQLiteQueryCursor*)cursorForQuery:(NSString*)query withParams:(id)params {
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutReaderDB:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return nil;
+    }
+    
+    SQLiteQueryCursor *cursor = [self cursorForQuery:query onDB:db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        [self bindParams:params toStatement:queryStatement];
+    } onClose:^{
+        [self checkinDB:db];
+    }];
+    
+    if(!cursor) {
+        [self checkinDB:db];
+    }
+    return cursor;
+}
+
+-(SQLiteQueryCursor*)cursorForQuery:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback {
+    if(dbToUse == NULL || *dbToUse == NULL) {
+        NSLog(@"[SQLITE] Invalid args");
+        return nil;
+    }
+    
+    // if db is passed caller must close
+    return [self cursorForQuery:query onDB:*dbToUse withBindParamsCallback:bindParamsCallback onClose:nil];
+}
+
+-(SQLiteQueryBlob*)openBlobInTable:(NSString*)table column:(NSString*)column rowid:(sqlite3_int64)rowid readOnly:(BOOL)readOnly {
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = readOnly ? [self checkoutReaderDB:&db] : [self checkoutWriterDB:&db withOpenDB:^int(sqlite3 **writerDB) {
+        return [self openDBReadWrite:writerDB];
+    }];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return nil;
+    }
+    
+    SQLiteQueryBlob *blob = [self openBlobInTable:table column:column rowid:rowid readOnly:readOnly onDB:db onClose:^{
+        [self checkinDB:db];
+    }];
+    
+    if(!blob) {
+        [self checkinDB:db];
+    }
+    return blob;
+}
+
+-(SQLiteQueryBlob*)openBlobInTable:(NSString*)table column:(NSString*)column rowid:(sqlite3_int64)rowid readOnly:(BOOL)readOnly withDB:(sqlite3**)dbToUse {
+    if(dbToUse == NULL || *dbToUse == NULL) {
+        NSLog(@"[SQLITE] Invalid args");
+        return nil;
+    }
+    
+    // if db is passed caller must close
+    return [self openBlobInTable:table column:column rowid:rowid readOnly:readOnly onDB:*dbToUse onClose:nil];
+}
+
+-(SQLiteQueryBlob*)openBlobInTable:(NSString*)table column:(NSString*)column rowid:(sqlite3_int64)rowid readOnly:(BOOL)readOnly onDB:(sqlite3*)db onClose:(void (^)())onClose {
+    
+    sqlite3_blob *openedBlob = NULL;
+    int blobOpenResult = sqlite3_blob_open(db, "main", [table UTF8String], [column UTF8String], rowid, readOnly ? 0 : 1, &openedBlob);
+    if(blobOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open blob %@.%@ at rowid %lld %d %s", table, column, rowid, blobOpenResult, sqlite3_errmsg(db));
+        sqlite3_blob_close(openedBlob);
+        return nil;
+    }
+    
+    // blob writes skip the update hook, invalidate cached reads of the table when the writer checks in
+    if(!readOnly) {
+        [self.resultCache noteChangedTable:[table UTF8String]];
+    }
+    
+    return [[SQLiteQueryBlob alloc] initWithBlob:openedBlob readOnly:readOnly onClose:^(sqlite3_blob *blob) {
+        int blobCloseResult = sqlite3_blob_close(blob);
+        if(blobCloseResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Failed to close blob %d %s", blobCloseResult, sqlite3_errstr(blobCloseResult));
+        }
+        if(onClose) {
+            onClose();
+        }
+    }];
+}
+
+-(SQLiteQueryCursor*)cursorForQuery:(NSString*)query onDB:(sqlite3*)db withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onClose:(void (^)())onClose {
+    if(![query isKindOfClass:[NSString class]]) {
+        NSLog(@"[SQLITE] Invalid query object type");
+        return nil;
+    }
+    
+    sqlite3_stmt *statement = NULL;
+    int prepareResponse = [self prepareStatement:&statement forQuery:query withDB:db];
+    if (prepareResponse != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error preparing query %s", sqlite3_errmsg(db));
+        [self finalizeStatement:statement forQuery:query withDB:db];
+        return nil;
+    }
+    
+    if(bindParamsCallback) {
+        bindParamsCallback(statement);
+    }
+    
+    NSString *cachedQuery = [query copy];
+    return [[SQLiteQueryCursor alloc] initWithStatement:statement onClose:^(sqlite3_stmt *cursorStatement) {
+        int finalizeResult = [self finalizeStatement:cursorStatement forQuery:cachedQuery withDB:db];
+        if(finalizeResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Error failed to finalize prepare statement %d", finalizeResult);
+        }
+        
+        if(onClose) {
+            onClose();
+        }
+    }];
+}
+
+// query should not include ;, limit will be inserted at the end
+-(void)enumerateObjectsMatchingQuery:(NSString*)query countQuery:(NSString*)countQuery bufferSize:(NSUInteger)bufferSize withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    if(!([query isKindOfClass:[NSString class]] && [countQuery isKindOfClass:[NSString class]] && bufferSize > 0)) {
+        NSLog(@"[SQLITE] Invalid query usage");
+        return;
+    }
+    
+    __block sqlite_int64 count = 0;
+    
+    [self queryDB:countQuery withDB:dbToUse withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+        
+    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        
+        count = sqlite3_column_int64(queryStatement, 0);
+        
+    } onQueryCompleteCallack:^{
+        
+    }];
+    
+    for(sqlite_int64 currentOffset = 0; currentOffset < count; currentOffset += (sqlite_int64)bufferSize) {
+        
+        NSString *nextQuery = [[NSString alloc] initWithFormat:@"%@ LIMIT %lu OFFSET %lld", query, (unsigned long)bufferSize, currentOffset];
+        
+        [self queryDB:nextQuery withDB:dbToUse withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+    }
+    
+}
+
+-(void)enumerateObjectsMatchingQuery:(NSString*)query keyColumn:(NSString*)keyColumn bufferSize:(NSUInteger)bufferSize withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutReaderDB:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        
+        if(onQueryCompleteCallack) {
+            onQueryCompleteCallack();
+        }
+        return;
+    }
+    
+    [self enumerateObjectsMatchingQuery:query keyColumn:keyColumn bufferSize:bufferSize withDB:&db withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:nil];
+    
+    [self checkinDB:db];
+    
+    if(onQueryCompleteCallack) {
+        onQueryCompleteCallack();
+    }
+}
+
+-(void)enumerateObjectsMatchingQuery:(NSString*)query keyColumn:(NSString*)keyColumn bufferSize:(NSUInteger)bufferSize withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+    if(!([query isKindOfClass:[NSString class]] && [keyColumn isKindOfClass:[NSString class]] && bufferSize > 0 && dbToUse != NULL && *dbToUse != NULL)) {
+        NSLog(@"[SQLITE] Invalid query usage");
+        
+        if(onQueryCompleteCallack) {
+            onQueryCompleteCallack();
+        }
+        return;
+    }
+    
+    sqlite3 *db = *dbToUse;
+    NSString *column = keyColumn;
+    
+    // a subquery does not expose rowid, the key has to be a named result column
+    // simple subqueries are flattened by sqlite so the seek reaches the index
+    NSString *quotedColumn = SQLiteQueryUtilQuoteIdentifier(column);
+    // >= so the first page starting at INT64_MIN includes a row keyed INT64_MIN, later pages start past the last key
+    NSString *pageQuery = [[NSString alloc] initWithFormat:@"SELECT * FROM (%@) WHERE %@ >= ? ORDER BY %@ LIMIT ?", query, quotedColumn, quotedColumn];
+    
+    sqlite3_stmt *statement = NULL;
+    int prepareResponse = [self prepareStatement:&statement forQuery:pageQuery withDB:db];
+    if (prepareResponse != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error preparing query %s", sqlite3_errmsg(db));
+    }
+    else {
+        int keyColumnIndex = -1;
+        int columnCount = sqlite3_column_count(statement);
+        for(int i = 0; i < columnCount; ++i) {
+            const char *columnName = sqlite3_column_name(statement, i);
+            if(columnName != NULL && sqlite3_stricmp(columnName, [column UTF8String]) == 0) {
+                keyColumnIndex = i;
+                break;
+            }
+        }
+        
+        if(keyColumnIndex < 0) {
+            NSLog(@"[SQLITE] Error key column %@ is not a result column of query", column);
+        }
+        else {
+            if(bindParamsCallback) {
+                bindParamsCallback(statement);
+            }
+            
+            // the seek and limit params follow the caller's params
+            int limitParamIndex = sqlite3_bind_parameter_count(statement);
+            int keyParamIndex = limitParamIndex - 1;
+            
+            sqlite3_int64 lastKey = INT64_MIN;
+            sqlite3_int64 pageStartKey = INT64_MIN;
+            NSUInteger currentRow = 0;
+            BOOL hasMorePages = YES;
+            BOOL invalidKey = NO;
+            
+            while(hasMorePages) {
+                sqlite3_bind_int64(statement, keyParamIndex, pageStartKey);
+                sqlite3_bind_int64(statement, limitParamIndex, (sqlite3_int64)bufferSize);
+                
+                NSUInteger pageRows = 0;
+                int rowResult = sqlite3_step(statement);
+                while(rowResult == SQLITE_ROW) {
+                    // text or real keys sort apart from integers and would repeat or skip pages, a tie would be skipped at a page boundary
+                    sqlite3_int64 key = sqlite3_column_int64(statement, keyColumnIndex);
+                    if(sqlite3_column_type(statement, keyColumnIndex) != SQLITE_INTEGER) {
+                        NSLog(@"[SQLITE] Error key column %@ must be INTEGER, row %lu has type %d", column, (unsigned long)currentRow, sqlite3_column_type(statement, keyColumnIndex));
+                        invalidKey = YES;
+                        break;
+                    }
+                    if(currentRow > 0 && key <= lastKey) {
+                        NSLog(@"[SQLITE] Error key column %@ must be unique, %lld repeats", column, key);
+                        invalidKey = YES;
+                        break;
+                    }
+                    lastKey = key;
+                    
+                    if(onNextRowCallback) {
+                        onNextRowCallback(statement, currentRow);
+                    }
+                    ++currentRow;
+                    ++pageRows;
+                    
+                    rowResult = sqlite3_step(statement);
+                }
+                
+                if(rowResult != SQLITE_DONE && !invalidKey) {
+                    NSLog(@"[SQLITE] Error unexpected last row result %d %s", rowResult, sqlite3_errmsg(db));
+                }
+                
+                // reset keeps the caller's bindings for the next page
+                sqlite3_reset(statement);
+                hasMorePages = !invalidKey && rowResult == SQLITE_DONE && pageRows == bufferSize;
+                
+                // keys are unique integers, nothing can follow INT64_MAX
+                if(hasMorePages && lastKey == INT64_MAX) {
+                    hasMorePages = NO;
+                }
+                if(hasMorePages) {
+                    pageStartKey = lastKey + 1;
+                }
+            }
+        }
+    }
+    
+    int finalizeResult = [self finalizeStatement:statement forQuery:pageQuery withDB:db];
+    if(finalizeResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to finalize prepare statement %d", finalizeResult);
+    }
+    
+    if(onQueryCompleteCallack) {
+        onQueryCompleteCallack();
+    }
+}
+
+-(sqlite3_int64)countOfQuery:(NSString*)query withParams:(id)params {
+    if(![query isKindOfClass:[NSString class]]) {
+        NSLog(@"[SQLITE] Invalid query usage");
+        return -1;
+    }
+    
+    __block sqlite3_int64 count = -1;
+    [self queryDB:[NSString stringWithFormat:@"SELECT COUNT(*) FROM (%@)", query] withParams:params onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        count = sqlite3_column_int64(queryStatement, 0);
+    } onQueryCompleteCallack:nil];
+    
+    return count;
+}
+
+-(sqlite3_int64)countOfQuery:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback {
+    if(!([query isKindOfClass:[NSString class]] && dbToUse != NULL && *dbToUse != NULL)) {
+        NSLog(@"[SQLITE] Invalid query usage");
+        return -1;
+    }
+    
+    __block sqlite3_int64 count = -1;
+    [self queryDB:[NSString stringWithFormat:@"SELECT COUNT(*) FROM (%@)", query] withDB:dbToUse withBindParamsCallback:bindParamsCallback onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        count = sqlite3_column_int64(queryStatement, 0);
+    } onQueryCompleteCallack:nil];
+    
+    return count;
+}
+
+-(BOOL)existsForQuery:(NSString*)query withParams:(id)params {
+    if(![query isKindOfClass:[NSString class]]) {
+        NSLog(@"[SQLITE] Invalid query usage");
+        return NO;
+    }
+    
+    __block BOOL exists = NO;
+    [self queryDB:[NSString stringWithFormat:@"SELECT EXISTS(SELECT 1 FROM (%@) LIMIT 1)", query] withParams:params onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        exists = sqlite3_column_int(queryStatement, 0) != 0;
+    } onQueryCompleteCallack:nil];
+    
+    return exists;
+}
+
+-(BOOL)existsForQuery:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback {
+    if(!([query isKindOfClass:[NSString class]] && dbToUse != NULL && *dbToUse != NULL)) {
+        NSLog(@"[SQLITE] Invalid query usage");
+        return NO;
+    }
+    
+    __block BOOL exists = NO;
+    [self queryDB:[NSString stringWithFormat:@"SELECT EXISTS(SELECT 1 FROM (%@) LIMIT 1)", query] withDB:dbToUse withBindParamsCallback:bindParamsCallback onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        exists = sqlite3_column_int(queryStatement, 0) != 0;
+    } onQueryCompleteCallack:nil];
+    
+    return exists;
+}
+
+-(BOOL)maintainRowCountForTable:(NSString*)table {
+    if(![table isKindOfClass:[NSString class]]) {
+        NSLog(@"[SQLITE] Invalid args");
+        return NO;
+    }
+    
+    NSString *quotedTable = SQLiteQueryUtilQuoteIdentifier(table);
+    NSString *tableLiteral = SQLiteQueryUtilQuoteLiteral(table);
+    NSString *insertTrigger = SQLiteQueryUtilQuoteIdentifier([NSString stringWithFormat:@"query_util_row_count_%@_ai", table]);
+    NSString *deleteTrigger = SQLiteQueryUtilQuoteIdentifier([NSString stringWithFormat:@"query_util_row_count_%@_ad", table]);
+    
+    NSArray *statements = @[@"CREATE TABLE IF NOT EXISTS query_util_row_count(table_name TEXT PRIMARY KEY NOT NULL, row_count INTEGER NOT NULL)",
+                            [NSString stringWithFormat:@"CREATE TRIGGER IF NOT EXISTS %@ AFTER INSERT ON %@ BEGIN UPDATE query_util_row_count SET row_count = row_count + 1 WHERE table_name = %@; END", insertTrigger, quotedTable, tableLiteral],
+                            [NSString stringWithFormat:@"CREATE TRIGGER IF NOT EXISTS %@ AFTER DELETE ON %@ BEGIN UPDATE query_util_row_count SET row_count = row_count - 1 WHERE table_name = %@; END", deleteTrigger, quotedTable, tableLiteral],
+                            // seeded in the same transaction as the triggers so no write is missed or counted twice, calling again reseeds
+                            [NSString stringWithFormat:@"INSERT OR REPLACE INTO query_util_row_count(table_name, row_count) SELECT %@, COUNT(*) FROM %@", tableLiteral, quotedTable]];
+    
+    return [self writeTransactionWithOperations:@[^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+        
+        for(NSString *statement in statements) {
+            int execResult = sqlite3_exec(db, [statement UTF8String], NULL, NULL, NULL);
+            if(execResult != SQLITE_OK) {
+                NSLog(@"[SQLITE] Error failed to maintain row count for %@ %d %s", table, execResult, sqlite3_errmsg(db));
+                return NO;
+            }
+        }
+        return YES;
+    }]];
+}
+
+-(sqlite3_int64)approximateCountOfTable:(NSString*)table {
+    if(![table isKindOfClass:[NSString class]]) {
+        NSLog(@"[SQLITE] Invalid args");
+        return -1;
+    }
+    
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutReaderDB:&db];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return -1;
+    }
+    
+    // either table may not exist yet, look before preparing against it
+    __block BOOL hasRowCounts = NO;
+    __block BOOL hasStats = NO;
+    [self queryDB:@"SELECT name FROM sqlite_master WHERE type = 'table' AND name IN ('query_util_row_count', 'sqlite_stat1')" withDB:&db withBindParamsCallback:nil onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        const char *name = (const char*)sqlite3_column_text(queryStatement, 0);
+        if(name && strcmp(name, "sqlite_stat1") == 0) {
+            hasStats = YES;
+        }
+        else if(name) {
+            hasRowCounts = YES;
+        }
+    } onQueryCompleteCallack:nil];
+    
+    __block sqlite3_int64 count = -1;
+    void (^bindTable)(sqlite3_stmt *queryStatement) = ^(sqlite3_stmt *queryStatement) {
+        sqlite3_bind_text(queryStatement, 1, [table UTF8String], -1, SQLITE_TRANSIENT);
+    };
+    
+    if(hasRowCounts) {
+        [self queryDB:@"SELECT row_count FROM query_util_row_count WHERE table_name = ?" withDB:&db withBindParamsCallback:bindTable onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+            count = sqlite3_column_int64(queryStatement, 0);
+        } onQueryCompleteCallack:nil];
+    }
+    
+    if(count < 0 && hasStats) {
+        // the first number of every stat row is the table's row count when ANALYZE last ran
+        [self queryDB:@"SELECT CAST(stat AS INTEGER) FROM sqlite_stat1 WHERE tbl = ? ORDER BY idx IS NULL DESC LIMIT 1" withDB:&db withBindParamsCallback:bindTable onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+            count = sqlite3_column_int64(queryStatement, 0);
+        } onQueryCompleteCallack:nil];
+    }
+    
+    if(count < 0) {
+        // nothing kept or analyzed, scan it
+        [self queryDB:[NSString stringWithFormat:@"SELECT COUNT(*) FROM %@", SQLiteQueryUtilQuoteIdentifier(table)] withDB:&db withBindParamsCallback:nil onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+            count = sqlite3_column_int64(queryStatement, 0);
+        } onQueryCompleteCallack:nil];
+    }
+    
+    [self checkinDB:db];
+    
+    return count;
+}
+
+-(void)migrate:(BOOL (^)())testConditionsExistToMigrate migrate:(void (^)())migrate didMigrationSucceed:(BOOL (^)())didMigrationSucceed rollback:(void (^)())rollback onMigrationComplete:(void (^)(BOOL didComplete))onMigrationComplete {
+    
+    BOOL migrationSucceeded = NO;
+    
+    BOOL shouldMigrate = testConditionsExistToMigrate();
+    
+    if(shouldMigrate) {
+        
+        migrate();
+        
+        migrationSucceeded = didMigrationSucceed();
+        
+        if(!migrationSucceeded) {
+            rollback();
+        }
+    }
+    
+    onMigrationComplete(migrationSucceeded);
+}
+
+-(BOOL)transaction:(BOOL (^)(sqlite3 **db))beginTransaction operationsInTransaction:(NSArray*)operationsInTransaction endTransaction:(BOOL (^)(BOOL transactionSucceeded, sqlite3 *db))endTransaction {
+    
+    sqlite3 *db = nil;
+    
+    // beginTransaction opens the db and executes begin transaction
+    BOOL transactionSucceess = beginTransaction(&db);
+    
+    if(transactionSucceess) {
+        
+        // allows results to be passed between operations
+        // ie insert row id result used as a foreign key in another statement
+        SQLiteQueryConnection *connection = [self pooledConnectionForDB:db];
+        SQLiteQueryTransactionContext *context = [[SQLiteQueryTransactionContext alloc] initWithDB:db connection:connection];
+        BOOL onWriter = connection && connection == self.writerConnection;
+        SQLiteQueryTransactionContext *enclosingContext = self.writerTransactionContext;
+        if(onWriter) {
+            context.changeSet = self.pendingChanges;
+            self.writerTransactionContext = context;
+        }
+        
+        for(SQLiteQueryUtilTransactionOperation nextOperation in operationsInTransaction) {
+            transactionSucceess &= nextOperation(db, context);
+            
+            if(!transactionSucceess) {
+                break;
+            }
+        }
+        
+        if(onWriter) {
+            self.writerTransactionContext = enclosingContext;
+        }
+        
+        // statements kept prepared across operations go back to the cache before commit
+        [context releaseStatements];
+    }
+    
+    // endTransaction executes commit/rollback and closes the db
+    transactionSucceess &= endTransaction(transactionSucceess, db);
+    
+    return transactionSucceess;
+}
+
+-(BOOL)createTransactionWithOperations:(NSArray*)operationsInTransaction {
+    return [self transactionWithOpenDB:^int(sqlite3 **db) {
+        return [self checkoutWriterDB:db withOpenDB:^int(sqlite3 **writerDB) {
+            return [self openForCreateDB:writerDB];
+        }];
+    } operations:operationsInTransaction];
+}
+
+-(BOOL)writeTransactionWithOperations:(NSArray*)operationsInTransaction {
+    return [self transactionWithOpenDB:^int(sqlite3 **db) {
+        return [self checkoutWriterDB:db withOpenDB:^int(sqlite3 **writerDB) {
+            return [self openDBReadWrite:writerDB];
+        }];
+    } operations:operationsInTransaction];
+}
+
+// retries the whole transaction with backoff while it fails on a locked database or a stale wal snapshot
+-(BOOL)transactionWithOpenDB:(int (^)(sqlite3** db))opendb operations:(NSArray*)operationsInTransaction {
+    
+    // called from an operation of a transaction on this thread, a BEGIN would fail and the ROLLBACK end the enclosing one
+    [self.writerLock lock];
+    SQLiteQueryTransactionContext *enclosingContext = self.writerTransactionContext;
+    if(enclosingContext) {
+        BOOL savepointSucceeded = [enclosingContext savepointWithOperations:operationsInTransaction];
+        [self.writerLock unlock];
+        return savepointSucceeded;
+    }
+    [self.writerLock unlock];
+    
+    void (^transactionMetricsHandler)(SQLiteQueryTransactionMetrics *metrics) = self.transactionMetricsHandler;
+    SQLiteQueryTransactionMetrics *metrics = transactionMetricsHandler ? [[SQLiteQueryTransactionMetrics alloc] init] : nil;
+    
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    NSUInteger attempt = 0;
+    BOOL transactionSucceeded = NO;
+    
+    while(YES) {
+        int failureCode = SQLITE_OK;
+        NSUInteger busyRetryCount = 0;
+        transactionSucceeded = [self transactionAttemptWithOpenDB:opendb operations:operationsInTransaction failureCode:&failureCode busyRetryCount:&busyRetryCount];
+        ++attempt;
+        
+        metrics.busyRetryCount += busyRetryCount;
+        metrics.resultCode = failureCode;
+        
+        BOOL retryable = !transactionSucceeded && (failureCode & 0xff) == SQLITE_BUSY;
+        if(!retryable || self.busyRetryDeadline <= 0) {
+            break;
+        }
+        
+        NSTimeInterval delay = [SQLiteQueryConnection backoffDelayForAttempt:attempt - 1 baseDelay:self.busyRetryBaseDelay maxDelay:self.busyRetryMaxDelay];
+        if(CFAbsoluteTimeGetCurrent() - startTime + delay > self.busyRetryDeadline) {
+            NSLog(@"[SQLITE] Transaction still busy after %lu attempts, giving up", (unsigned long)attempt);
+            break;
+        }
+        
+        usleep((useconds_t)(delay * USEC_PER_SEC));
+    }
+    
+    if(metrics) {
+        metrics.attemptCount = attempt;
+        metrics.succeeded = transactionSucceeded;
+        metrics.totalDuration = CFAbsoluteTimeGetCurrent() - startTime;
+        transactionMetricsHandler(metrics);
+    }
+    
+    return transactionSucceeded;
+}
+
+-(BOOL)transactionAttemptWithOpenDB:(int (^)(sqlite3** db))opendb operations:(NSArray*)operationsInTransaction failureCode:(int*)failureCode busyRetryCount:(NSUInteger*)busyRetryCount {
+    
+    __block NSUInteger busyRetryCountAtOpen = 0;
+    
+    BOOL(^closedb)(sqlite3*) = ^BOOL(sqlite3 *db) {
+        SQLiteQueryConnection *connection = [self pooledConnectionForDB:db];
+        if(connection) {
+            *busyRetryCount = connection.busyRetryCount - busyRetryCountAtOpen;
+        }
+
+        // pooled writer is checked back in, a failed open is closed
+        int closeResult = [self checkinDB:db];
+        BOOL closeSuccess = closeResult == SQLITE_OK;
+        if(closeResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Error failed to close db %d", closeResult);
+        }
+        return closeSuccess;
+    };
+    
+    // the failing operation's own error decides the retry, not one an earlier operation handled
+    NSMutableArray *recordingOperations = [[NSMutableArray alloc] initWithCapacity:operationsInTransaction.count];
+    for(SQLiteQueryUtilTransactionOperation operation in operationsInTransaction) {
+        [recordingOperations addObject:^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            // an empty sqlite3_exec resets the connection's error code
+            sqlite3_exec(db, "", 0, 0, 0);
+            BOOL operationSucceeded = operation(db, context);
+            if(!operationSucceeded) {
+                int errorCode = sqlite3_extended_errcode(db);
+                // failed without a sqlite error, never retried
+                *failureCode = errorCode != SQLITE_OK ? errorCode : SQLITE_ERROR;
+            }
+            return operationSucceeded;
+        }];
+    }
+    
+    return [self transaction:^BOOL(sqlite3 **dbPtr){
+        sqlite3 *db = NULL;
+        int dbOpenResult = opendb(&db); // todo check opendb block ref strong/weak
+        *dbPtr = db;
+        
+        BOOL beginTransactionSuccess = dbOpenResult == SQLITE_OK;
+        if(!beginTransactionSuccess) {
+            *failureCode = dbOpenResult;
+        }
+        
+        if (beginTransactionSuccess) {
+            busyRetryCountAtOpen = [self pooledConnectionForDB:db].busyRetryCount;
+            
+            // http://sqlite.org/lang_transaction.html
+            // IMMEDIATE (Rather than exclusive) allows readonly queries inside the transaction
+            // without error but changes (insert, update, delete) executed within the
+            // transaction are  not visible
+            int beginResponse = sqlite3_exec(db, "BEGIN IMMEDIATE TRANSACTION", 0, 0, 0);
+            beginTransactionSuccess &= beginResponse == SQLITE_OK;
+            if(beginResponse != SQLITE_OK) {
+                *failureCode = sqlite3_extended_errcode(db);
+                NSLog(@"[SQLITE] Begin Transaction Error: %d %s",beginResponse, sqlite3_errmsg(db));
+            }
+        }
+        
+        return beginTransactionSuccess;
+        
+    } operationsInTransaction:recordingOperations endTransaction:^BOOL(BOOL transactionSucceeded, sqlite3 *db) {
+        BOOL wholeTransactionSucceeded = transactionSucceeded;
+        
+        if(!transactionSucceeded) {
+            // failureCode is set by the failed open, begin or operation, SQLITE_BUSY_SNAPSHOT or SQLITE_BUSY make it retryable
+            int rollbackResponse = sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
+            if (rollbackResponse != SQLITE_OK) {
+                NSLog(@"[SQLITE] Rollback Error: %d %s",rollbackResponse, sqlite3_errmsg(db));
+            }
+        }
+        else {
+            int commitResponse = sqlite3_exec(db, "COMMIT TRANSACTION", 0, 0, 0);
+            wholeTransactionSucceeded &= commitResponse == SQLITE_OK;
+            if (commitResponse != SQLITE_OK) {
+                // still pending, the rollback at checkin or a retry's ROLLBACK discards them before the replay records them again
+                *failureCode = sqlite3_extended_errcode(db);
+                NSLog(@"[SQLITE] Commit Transaction Error: %d %s",commitResponse, sqlite3_errmsg(db));
+            }
+            else {
+                SQLiteQueryConnection *connection = [self pooledConnectionForDB:db];
+                if(connection && !connection.isReadOnly) {
+                    [self writerDidCommit];
+                }
+            }
+        }
+        
+        wholeTransactionSucceeded &= closedb(db);
+        
+        return wholeTransactionSucceeded;
+    }];
+}
+
+-(BOOL)bulkInsertIntoTable:(NSString*)table columns:(NSArray*)columns rows:(NSArray*)rows {
+    if(![rows isKindOfClass:[NSArray class]]) {
+        NSLog(@"[SQLITE] Invalid args");
+        return NO;
+    }
+    
+    NSUInteger columnCount = columns.count;
+    
+    return [self bulkInsertIntoTable:table columns:columns rowsPerStatement:SQLiteQueryUtilDefaultBulkInsertRowsPerStatement chunkSize:SQLiteQueryUtilDefaultBulkInsertChunkSize rowCount:rows.count rowProvider:^BOOL(sqlite3_stmt *insertStatement, int firstParamIndex, NSUInteger row) {
+        
+        NSArray *values = [rows objectAtIndex:row];
+        if(![values isKindOfClass:[NSArray class]] || values.count != columnCount) {
+            NSLog(@"[SQLITE] Invalid bulk insert row %lu", (unsigned long)row);
+            return NO;
+        }
+        
+        for(NSUInteger column = 0; column < columnCount; ++column) {
+            if(SQLiteQueryBindObject(insertStatement, firstParamIndex + (int)column, [values objectAtIndex:column]) != SQLITE_OK) {
+                return NO;
+            }
+        }
+        return YES;
+    }];
+}
+
+-(BOOL)bulkInsertIntoTable:(NSString*)table columns:(NSArray*)columns rowsPerStatement:(NSUInteger)rowsPerStatement chunkSize:(NSUInteger)chunkSize rowCount:(NSUInteger)rowCount rowProvider:(BOOL (^)(sqlite3_stmt *insertStatement, int firstParamIndex, NSUInteger row))rowProvider {
+    if(!([table isKindOfClass:[NSString class]] && [columns isKindOfClass:[NSArray class]] && columns.count > 0 && rowProvider)) {
+        NSLog(@"[SQLITE] Invalid args");
+        return NO;
+    }
+    
+    NSUInteger columnCount = columns.count;
+    NSMutableArray *quotedColumns = [[NSMutableArray alloc] initWithCapacity:columnCount];
+    for(id column in columns) {
+        if(![column isKindOfClass:[NSString class]]) {
+            NSLog(@"[SQLITE] Invalid bulk insert column %@", column);
+            return NO;
+        }
+        [quotedColumns addObject:SQLiteQueryUtilQuoteIdentifier(column)];
+    }
+    NSString *quotedTable = SQLiteQueryUtilQuoteIdentifier(table);
+    NSString *columnList = [quotedColumns componentsJoinedByString:@","];
+    
+    NSMutableArray *placeholders = [[NSMutableArray alloc] initWithCapacity:columnCount];
+    for(NSUInteger column = 0; column < columnCount; ++column) {
+        [placeholders addObject:@"?"];
+    }
+    NSString *rowValues = [NSString stringWithFormat:@"(%@)", [placeholders componentsJoinedByString:@","]];
+    
+    NSUInteger rowsPerChunk = chunkSize > 0 ? chunkSize : rowCount;
+    
+    for(NSUInteger chunkStart = 0; chunkStart < rowCount; chunkStart += rowsPerChunk) {
+        NSUInteger chunkEnd = MIN(chunkStart + rowsPerChunk, rowCount);
+        
+        BOOL chunkCommitted = [self writeTransactionWithOperations:@[^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            
+            // never exceed the variables a single statement can bind
+            NSUInteger maxRowsPerStatement = MAX((NSUInteger)sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1) / columnCount, (NSUInteger)1);
+            NSUInteger multiRowCount = MIN(MAX(rowsPerStatement, (NSUInteger)1), maxRowsPerStatement);
+            
+            NSUInteger row = chunkStart;
+            
+            if(multiRowCount > 1 && chunkEnd - row >= multiRowCount) {
+                NSMutableArray *multiRowValues = [[NSMutableArray alloc] initWithCapacity:multiRowCount];
+                for(NSUInteger i = 0; i < multiRowCount; ++i) {
+                    [multiRowValues addObject:rowValues];
+                }
+                NSString *multiRowQuery = [NSString stringWithFormat:@"INSERT INTO %@ (%@) VALUES %@", quotedTable, columnList, [multiRowValues componentsJoinedByString:@","]];
+                
+                BOOL success = [self executeInsert:multiRowQuery withDB:db rowsPerStatement:multiRowCount columnCount:columnCount fromRow:&row toRow:chunkEnd rowProvider:rowProvider];
+                if(!success) {
+                    return NO;
+                }
+            }
+            
+            // single row statement for the remainder
+            NSString *singleRowQuery = [NSString stringWithFormat:@"INSERT INTO %@ (%@) VALUES %@", quotedTable, columnList, rowValues];
+            return [self executeInsert:singleRowQuery withDB:db rowsPerStatement:1 columnCount:columnCount fromRow:&row toRow:chunkEnd rowProvider:rowProvider];
+        }]];
+        
+        if(!chunkCommitted) {
+            NSLog(@"[SQLITE] Bulk insert into %@ failed at row %lu", table, (unsigned long)chunkStart);
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+// steps query for as many whole statements of rowsPerStatement rows as fit before toRow, advancing *row
+-(BOOL)executeInsert:(NSString*)query withDB:(sqlite3*)db rowsPerStatement:(NSUInteger)rowsPerStatement columnCount:(NSUInteger)columnCount fromRow:(NSUInteger*)row toRow:(NSUInteger)toRow rowProvider:(BOOL (^)(sqlite3_stmt *insertStatement, int firstParamIndex, NSUInteger row))rowProvider {
+    if(toRow - *row < rowsPerStatement) {
+        return YES;
+    }
+    
+    sqlite3_stmt *statement = NULL;
+    int prepareResponse = [self prepareStatement:&statement forQuery:query withDB:db];
+    if (prepareResponse != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error preparing query %s", sqlite3_errmsg(db));
+        [self finalizeStatement:statement forQuery:query withDB:db];
+        return NO;
+    }
+    
+    BOOL success = YES;
+    
+    while(success && toRow - *row >= rowsPerStatement) {
+        @autoreleasepool {
+            for(NSUInteger i = 0; i < rowsPerStatement && success; ++i) {
+                success = rowProvider(statement, (int)(1 + i * columnCount), *row + i);
+            }
+            
+            if(success) {
+                int stepResult = sqlite3_step(statement);
+                if(stepResult != SQLITE_DONE) {
+                    NSLog(@"[SQLITE] Error unexpected last row result %d %s", stepResult, sqlite3_errmsg(db));
+                    success = NO;
+                }
+            }
+            sqlite3_reset(statement);
+        }
+        
+        if(success) {
+            *row += rowsPerStatement;
+        }
+    }
+    
+    int finalizeResult = [self finalizeStatement:statement forQuery:query withDB:db];
+    if(finalizeResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Error failed to finalize prepare statement %d", finalizeResult);
+    }
+    
+    return success;
+}
+
+-(void)enqueueWriteTransactionWithOperations:(NSArray*)operationsInTransaction completionQueue:(dispatch_queue_t)completionQueue onTransactionComplete:(void (^)(BOOL transactionSucceeded))onTransactionComplete {
+    
+    SQLiteQueryUtilPendingWrite *pendingWrite = [[SQLiteQueryUtilPendingWrite alloc] init];
+    pendingWrite.operationsInTransaction = operationsInTransaction;
+    pendingWrite.completionQueue = completionQueue ?: dispatch_get_main_queue();
+    pendingWrite.onTransactionComplete = onTransactionComplete;
+    
+    BOOL scheduleGroupCommit = NO;
+    BOOL groupIsFull = NO;
+    
+    @synchronized(self.pendingWrites) {
+        [self.pendingWrites addObject:pendingWrite];
+        
+        scheduleGroupCommit = !self.groupCommitScheduled;
+        self.groupCommitScheduled = YES;
+        groupIsFull = self.pendingWrites.count >= self.groupCommitMaxTransactions;
+    }
+    
+    if(groupIsFull) {
+        // no reason to wait out the delay
+        dispatch_async(self.writerQueue, ^{
+            [self drainPendingWrites];
+        });
+    }
+    else if(scheduleGroupCommit) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.groupCommitMaxDelay * NSEC_PER_SEC)), self.writerQueue, ^{
+            [self drainPendingWrites];
+        });
+    }
+}
+
+// runs on writerQueue, commits groups until nothing is pending
+-(void)drainPendingWrites {
+    while(YES) {
+        NSArray *group = nil;
+        
+        @synchronized(self.pendingWrites) {
+            NSUInteger groupSize = MIN(self.pendingWrites.count, MAX(self.groupCommitMaxTransactions, (NSUInteger)1));
+            if(groupSize == 0) {
+                self.groupCommitScheduled = NO;
+                return;
+            }
+            
+            NSRange groupRange = NSMakeRange(0, groupSize);
+            group = [self.pendingWrites subarrayWithRange:groupRange];
+            [self.pendingWrites removeObjectsInRange:groupRange];
+        }
+        
+        [self groupCommitPendingWrites:group];
+    }
+}
+
+-(void)groupCommitPendingWrites:(NSArray*)group {
+    
+    // each pending write gets its own savepoint inside the group transaction
+    NSMutableArray *groupOperations = [[NSMutableArray alloc] initWithCapacity:group.count];
+    for(SQLiteQueryUtilPendingWrite *pendingWrite in group) {
+        SQLiteQueryUtilTransactionOperation savepointOperation = ^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            
+            pendingWrite.transactionSucceeded = [self transaction:^BOOL(sqlite3 **dbPtr) {
+                *dbPtr = db;
+                int savepointResponse = sqlite3_exec(db, "SAVEPOINT group_commit", 0, 0, 0);
+                if(savepointResponse != SQLITE_OK) {
+                    NSLog(@"[SQLITE] Savepoint Error: %d %s",savepointResponse, sqlite3_errmsg(db));
+                }
+                else {
+                    // ROLLBACK TO fires no rollback hook, the change feed needs its own mark
+                    [self.pendingChanges beginSavepoint];
+                }
+                return savepointResponse == SQLITE_OK;
+                
+            } operationsInTransaction:pendingWrite.operationsInTransaction endTransaction:^BOOL(BOOL transactionSucceeded, sqlite3 *savepointDB) {
+                
+                if(!transactionSucceeded) {
+                    int rollbackResponse = sqlite3_exec(savepointDB, "ROLLBACK TO group_commit", 0, 0, 0);
+                    if (rollbackResponse != SQLITE_OK) {
+                        NSLog(@"[SQLITE] Rollback Error: %d %s",rollbackResponse, sqlite3_errmsg(savepointDB));
+                    }
+                    [self.pendingChanges rollbackToSavepoint];
+                }
+                
+                int releaseResponse = sqlite3_exec(savepointDB, "RELEASE group_commit", 0, 0, 0);
+                if (releaseResponse != SQLITE_OK) {
+                    NSLog(@"[SQLITE] Release Savepoint Error: %d %s",releaseResponse, sqlite3_errmsg(savepointDB));
+                }
+                [self.pendingChanges releaseSavepoint];
+                return transactionSucceeded && releaseResponse == SQLITE_OK;
+            }];
+            
+            // a failed member never fails the group
+            return YES;
+        };
+        [groupOperations addObject:savepointOperation];
+    }
+    
+    BOOL groupCommitted = [self writeTransactionWithOperations:groupOperations];
+    
+    for(SQLiteQueryUtilPendingWrite *pendingWrite in group) {
+        BOOL transactionSucceeded = groupCommitted && pendingWrite.transactionSucceeded;
         
-        if(closeResult != SQLITE_OK) {
-            NSLog(@"[SQLITE] Error failed to close db %d %s", closeResult, sqlite3_errmsg(db));
+        if(pendingWrite.onTransactionComplete) {
+            void (^onTransactionComplete)(BOOL) = pendingWrite.onTransactionComplete;
+            dispatch_async(pendingWrite.completionQueue, ^{
+                onTransactionComplete(transactionSucceeded);
+            });
         }
+    }
+}
+
+-(void)backupToPath:(NSString*)path pagesPerStep:(int)pagesPerStep progress:(void (^)(int remainingPages, int pageCount))progress completionQueue:(dispatch_queue_t)completionQueue onBackupComplete:(void (^)(BOOL backupSucceeded))onBackupComplete {
+    
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    
+    dispatch_async(self.maintenanceQueue, ^{
+        BOOL backupSucceeded = [self backupToPath:path pagesPerStep:pagesPerStep progress:progress callbackQueue:callbackQueue];
         
-        // end here, callback or not
-        if(onQueryCompleteCallack) {
-            onQueryCompleteCallack();
+        if(onBackupComplete) {
+            dispatch_async(callbackQueue, ^{
+                onBackupComplete(backupSucceeded);
+            });
         }
-        return;
+    });
+}
+
+-(BOOL)backupToPath:(NSString*)path pagesPerStep:(int)pagesPerStep progress:(void (^)(int remainingPages, int pageCount))progress callbackQueue:(dispatch_queue_t)callbackQueue {
+    
+    sqlite3 *destinationDB = NULL;
+    int dbOpenResult = sqlite3_open_v2([path UTF8String], &destinationDB, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open backup database %d %s", dbOpenResult, sqlite3_errmsg(destinationDB));
+        sqlite3_close(destinationDB);
+        return NO;
     }
     
-    /*
-     int enableExtendedResultCode = sqlite3_extended_result_codes(db, 1);
-     if(enableExtendedResultCode != 0) {
-     NSLog(@"[SQLITE] Error Failed to enable extended result codes: %d", enableExtendedResultCode);
-     }
-     */
+    sqlite3_backup *backup = NULL;
+    int stepResult = SQLITE_OK;
     
-    sqlite3_stmt *statement = NULL;
-    const char *sql = [query UTF8String];
-    int prepareResponse = sqlite3_prepare_v2(db, sql, -1, &statement, NULL);
-    if (prepareResponse != SQLITE_OK) {
-        NSLog(@"[SQLITE] Error preparing query %s", sqlite3_errmsg(db));
-    } else {
+    while(stepResult == SQLITE_OK || stepResult == SQLITE_BUSY || stepResult == SQLITE_LOCKED) {
         
-        if(bindParamsCallback) {
-            bindParamsCallback(statement);
+        // a step runs on the writer so changes it makes between steps are applied to the copy instead of restarting it
+        sqlite3 *db = NULL;
+        dbOpenResult = [self checkoutWriterDB:&db withOpenDB:^int(sqlite3 **writerDB) {
+            return [self openDBReadWrite:writerDB];
+        }];
+        if(dbOpenResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+            [self checkinDB:db];
+            stepResult = dbOpenResult;
+            break;
         }
         
-        NSUInteger currentRow = 0;
-        
-        int rowResult = sqlite3_step(statement);
-        while(rowResult == SQLITE_ROW) {
-            if(onNextRowCallback) {
-                onNextRowCallback(statement, currentRow);
+        if(backup == NULL) {
+            backup = sqlite3_backup_init(destinationDB, "main", db, "main");
+            if(backup == NULL) {
+                NSLog(@"[SQLITE] Failed to start backup %s", sqlite3_errmsg(destinationDB));
+                [self checkinDB:db];
+                stepResult = sqlite3_errcode(destinationDB);
+                break;
             }
-            ++currentRow;
-            
-            rowResult = sqlite3_step(statement);
         }
         
-        if(rowResult == SQLITE_DONE) {
-            // for insert execute onNextRowCallback once for caller to retrieve row id via
-            // execute sqlite3_last_insert_rowid
-            if(isWriteQuery && currentRow == 0 && onNextRowCallback) {
-                onNextRowCallback(statement, currentRow);
-            }
+        stepResult = sqlite3_backup_step(backup, pagesPerStep > 0 ? pagesPerStep : -1);
+        int remainingPages = sqlite3_backup_remaining(backup);
+        int pageCount = sqlite3_backup_pagecount(backup);
+        
+        [self checkinDB:db];
+        
+        if(progress) {
+            dispatch_async(callbackQueue, ^{
+                progress(remainingPages, pageCount);
+            });
         }
-        else {
-            NSLog(@"[SQLITE] Error unexpected last row result %d %s", rowResult, sqlite3_errmsg(db));
+        
+        if(stepResult != SQLITE_DONE) {
+            // let queued writes take the writer before the next step
+            [NSThread sleepForTimeInterval:SQLiteQueryUtilBackupStepDelay];
         }
     }
     
-    int finalizeResult = sqlite3_finalize(statement);
-    if(finalizeResult != SQLITE_OK) {
-        NSLog(@"[SQLITE] Error failed to finalize prepare statement %d", finalizeResult);
-    }
-    else {
-        statement = nil;
+    if(backup != NULL) {
+        int finishResult = sqlite3_backup_finish(backup);
+        if(stepResult == SQLITE_DONE && finishResult != SQLITE_OK) {
+            stepResult = finishResult;
+        }
     }
     
-    int closeResult = 0;
-    
-    bool callCloseBlock = closedb != nil;
-    if(callCloseBlock) {
-        closeResult = closedb(db);
-    }
-    else {
-        closeResult = sqlite3_close(db);
+    if(stepResult != SQLITE_DONE) {
+        NSLog(@"[SQLITE] Backup failed %d %s", stepResult, sqlite3_errstr(stepResult));
     }
     
+    int closeResult = sqlite3_close(destinationDB);
     if(closeResult != SQLITE_OK) {
-        NSLog(@"[SQLITE] Error failed to close db %d", closeResult);
+        NSLog(@"[SQLITE] Error failed to close db %d %s", closeResult, sqlite3_errmsg(destinationDB));
     }
     
-    if(onQueryCompleteCallack) {
-        onQueryCompleteCallack();
-    }
+    return stepResult == SQLITE_DONE;
 }
 
--(void)queryDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+-(void)vacuumIntoPath:(NSString*)path completionQueue:(dispatch_queue_t)completionQueue onVacuumComplete:(void (^)(BOOL vacuumSucceeded))onVacuumComplete {
     
-    [self openDB:^int(sqlite3 **db) {
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    
+    dispatch_async(self.maintenanceQueue, ^{
+        BOOL vacuumSucceeded = NO;
         
-        return [self openDBReadOnly:db];
+        sqlite3 *db = NULL;
+        int dbOpenResult = [self checkoutReaderDB:&db];
+        if(dbOpenResult == SQLITE_OK) {
+            sqlite3_stmt *statement = NULL;
+            int prepareResult = sqlite3_prepare_v2(db, "VACUUM INTO ?", -1, &statement, NULL);
+            if(prepareResult == SQLITE_OK && SQLiteQueryBindObject(statement, 1, path) == SQLITE_OK) {
+                int stepResult = sqlite3_step(statement);
+                vacuumSucceeded = stepResult == SQLITE_DONE;
+                if(!vacuumSucceeded) {
+                    NSLog(@"[SQLITE] Vacuum into %@ failed %d %s", path, stepResult, sqlite3_errmsg(db));
+                }
+            }
+            else {
+                NSLog(@"[SQLITE] Failed to prepare vacuum %d %s", prepareResult, sqlite3_errmsg(db));
+            }
+            sqlite3_finalize(statement);
+        }
+        else {
+            NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        }
+        [self checkinDB:db];
         
-    } closedb:nil andExecuteSQL:query isWriteQuery:NO withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+        if(onVacuumComplete) {
+            dispatch_async(callbackQueue, ^{
+                onVacuumComplete(vacuumSucceeded);
+            });
+        }
+    });
 }
 
--(void)queryDB:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+-(void)registerMigrationToVersion:(int32_t)version statements:(NSArray*)statements {
     
-    [self openDB:^int(sqlite3 **db) {
-        
-        *(db) = *dbToUse;
-        return SQLITE_OK;
-        
-    } closedb:^int(sqlite3 *db) {
-        
-        // if db is passed caller must close
-        return SQLITE_OK;
-        
-    } andExecuteSQL:query isWriteQuery:NO withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+    NSMutableArray *operations = [[NSMutableArray alloc] initWithCapacity:statements.count];
+    for(NSString *statement in statements) {
+        SQLiteQueryUtilTransactionOperation operation = ^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            char *errorMessage = NULL;
+            int execResult = sqlite3_exec(db, [statement UTF8String], NULL, NULL, &errorMessage);
+            if(execResult != SQLITE_OK) {
+                NSLog(@"[SQLITE_MIGRATOR] Migration to v%d failed %d %s", version, execResult, errorMessage);
+            }
+            sqlite3_free(errorMessage);
+            return execResult == SQLITE_OK;
+        };
+        [operations addObject:operation];
+    }
+    
+    [self registerMigrationToVersion:version operations:operations];
 }
 
--(void)writeQueryInDB:(NSString*)query withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
-    
-    [self openDB:^int(sqlite3 **db) {
-        
-        *(db) = *dbToUse;
-        return SQLITE_OK;
-        
-    } closedb:^int(sqlite3 *db) {
-        
-        // if db is passed caller must close
-        return SQLITE_OK;
-        
-    } andExecuteSQL:query isWriteQuery:YES withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+-(void)registerMigrationToVersion:(int32_t)version operations:(NSArray*)operations {
+    @synchronized(self.migrationsByVersion) {
+        [self.migrationsByVersion setObject:[operations copy] forKey:@(version)];
+    }
 }
 
--(void)writeQueryInDB:(NSString*)query withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
+-(BOOL)runMigrations {
     
-    [self openDB:^int(sqlite3 **db) {
+    NSDictionary *migrationsByVersion = nil;
+    @synchronized(self.migrationsByVersion) {
+        migrationsByVersion = [self.migrationsByVersion copy];
+    }
+    NSArray *versions = [[migrationsByVersion allKeys] sortedArrayUsingSelector:@selector(compare:)];
+    
+    // hold the writer so the version read stays current while migrating
+    sqlite3 *db = NULL;
+    int dbOpenResult = [self checkoutWriterDB:&db withOpenDB:^int(sqlite3 **writerDB) {
+        return [self openForCreateDB:writerDB];
+    }];
+    if(dbOpenResult != SQLITE_OK) {
+        NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(db));
+        [self checkinDB:db];
+        return NO;
+    }
+    
+    int32_t currentVersion = [self dbVersionWithDB:&db];
+    BOOL migrationsSucceeded = YES;
+    
+    for(NSNumber *version in versions) {
+        int32_t targetVersion = [version intValue];
+        if(targetVersion <= currentVersion) {
+            continue;
+        }
         
-        return [self openDBReadWrite:db];
+        SQLiteQueryUtilTransactionOperation bumpVersion = ^BOOL(sqlite3 *transactionDB, SQLiteQueryTransactionContext *context) {
+            return [self setdbVersion:targetVersion withDB:&transactionDB];
+        };
+        NSArray *operations = [[migrationsByVersion objectForKey:version] arrayByAddingObject:bumpVersion];
         
-    } closedb:nil andExecuteSQL:query isWriteQuery:YES withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+        NSLog(@"[SQLITE_MIGRATOR] Migration from v%d to v%d", currentVersion, targetVersion);
+        if(![self createTransactionWithOperations:operations]) {
+            NSLog(@"[SQLITE_MIGRATOR] Migration from v%d to v%d FAIL", currentVersion, targetVersion);
+            migrationsSucceeded = NO;
+            break;
+        }
+        currentVersion = targetVersion;
+    }
+    
+    [self checkinDB:db];
+    return migrationsSucceeded;
 }
 
-// query should not include ;, limit will be inserted at the end
--(void)enumerateObjectsMatchingQuery:(NSString*)query countQuery:(NSString*)countQuery bufferSize:(NSUInteger)bufferSize withDB:(sqlite3**)dbToUse withBindParamsCallback:(void (^)(sqlite3_stmt *queryStatement))bindParamsCallback onNextRowCallback:(void (^)(sqlite3_stmt *queryStatement, NSUInteger currentRow))onNextRowCallback onQueryCompleteCallack:(void(^)())onQueryCompleteCallack {
-    if(!([query isKindOfClass:[NSString class]] && [countQuery isKindOfClass:[NSString class]] && bufferSize > 0)) {
-        NSLog(@"[SQLITE] Invalid query usage");
-        return;
+-(void)registerBackfillNamed:(NSString*)name forVersion:(int32_t)version chunkSize:(NSUInteger)chunkSize chunk:(SQLiteQueryUtilBackfillChunk)chunk {
+    
+    SQLiteQueryUtilBackfill *backfill = [[SQLiteQueryUtilBackfill alloc] init];
+    backfill.name = name;
+    backfill.version = version;
+    backfill.chunkSize = chunkSize;
+    backfill.chunk = chunk;
+    
+    @synchronized(self.backfills) {
+        [self.backfills addObject:backfill];
     }
+}
+
+-(void)runBackfillsWithCompletionQueue:(dispatch_queue_t)completionQueue onBackfillsComplete:(void (^)(BOOL backfillsFinished))onBackfillsComplete {
     
-    sqlite_int64 currentOffset = 0;
-    __block sqlite_int64 count = 0;
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
     
-    [self queryDB:countQuery withDB:dbToUse withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
-        
-    } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+    NSArray *backfills = nil;
+    @synchronized(self.backfills) {
+        backfills = [self.backfills copy];
+    }
+    
+    dispatch_async(self.maintenanceQueue, ^{
+        BOOL backfillsFinished = [self writeTransactionWithOperations:@[^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            return sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS query_util_backfill(name TEXT PRIMARY KEY NOT NULL, last_key INTEGER NOT NULL, finished INTEGER NOT NULL)", NULL, NULL, NULL) == SQLITE_OK;
+        }]];
         
-        // todo int or int64
-        count = sqlite3_column_int(queryStatement, 0);
+        int32_t currentVersion = backfillsFinished ? [self dbVersion] : 0;
         
-    } onQueryCompleteCallack:^{
+        for(SQLiteQueryUtilBackfill *backfill in backfills) {
+            if(!backfillsFinished) {
+                break;
+            }
+            if(backfill.version > currentVersion) {
+                continue;
+            }
+            backfillsFinished = [self runBackfill:backfill];
+        }
         
-    }];
+        if(onBackfillsComplete) {
+            dispatch_async(callbackQueue, ^{
+                onBackfillsComplete(backfillsFinished);
+            });
+        }
+    });
+}
+
+-(BOOL)runBackfill:(SQLiteQueryUtilBackfill*)backfill {
     
-    if(((sqlite_int64)bufferSize) >= count) {
-        bufferSize = ((NSUInteger)count)-1;
-    }
+    __block sqlite3_int64 lastKey = 0;
+    __block BOOL finished = NO;
+    
+    [self queryDB:@"SELECT last_key, finished FROM query_util_backfill WHERE name = ?" withParams:@[backfill.name] onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+        lastKey = sqlite3_column_int64(queryStatement, 0);
+        finished = sqlite3_column_int(queryStatement, 1) != 0;
+    } onQueryCompleteCallack:nil];
     
-    for(; (bufferSize+currentOffset >= count ? (count-currentOffset) : bufferSize+currentOffset) < count; currentOffset += bufferSize) {
+    while(!finished) {
+        __block sqlite3_int64 chunkLastKey = lastKey;
+        __block BOOL chunkFinished = NO;
         
-        NSString *nextQuery = [[NSString alloc] initWithFormat:@"%@ LIMIT %lu OFFSET %lld", query, (unsigned long)bufferSize, currentOffset];
+        SQLiteQueryUtilTransactionOperation runChunk = ^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            chunkLastKey = lastKey;
+            chunkFinished = NO;
+            return backfill.chunk(db, &chunkLastKey, backfill.chunkSize, &chunkFinished);
+        };
+        SQLiteQueryUtilTransactionOperation saveCheckpoint = ^BOOL(sqlite3 *db, SQLiteQueryTransactionContext *context) {
+            __block BOOL success = NO;
+            [self writeQueryInDB:@"INSERT OR REPLACE INTO query_util_backfill(name, last_key, finished) VALUES(?, ?, ?)" withDB:&db withBindParamsCallback:^(sqlite3_stmt *queryStatement) {
+                [self bindParams:@[backfill.name, @(chunkLastKey), @(chunkFinished)] toStatement:queryStatement];
+            } onNextRowCallback:^(sqlite3_stmt *queryStatement, NSUInteger currentRow) {
+                success = YES;
+            } onQueryCompleteCallack:nil];
+            return success;
+        };
         
-        [self queryDB:nextQuery withDB:dbToUse withBindParamsCallback:bindParamsCallback onNextRowCallback:onNextRowCallback onQueryCompleteCallack:onQueryCompleteCallack];
+        if(![self writeTransactionWithOperations:@[runChunk, saveCheckpoint]]) {
+            NSLog(@"[SQLITE_MIGRATOR] Backfill %@ stopped after key %lld", backfill.name, lastKey);
+            return NO;
+        }
+        
+        lastKey = chunkLastKey;
+        finished = chunkFinished;
+        
+        if(!finished) {
+            // let queued writes take the writer before the next chunk
+            [NSThread sleepForTimeInterval:SQLiteQueryUtilBackfillChunkDelay];
+        }
     }
     
+    return YES;
 }
 
--(void)migrate:(BOOL (^)())testConditionsExistToMigrate migrate:(void (^)())migrate didMigrationSucceed:(BOOL (^)())didMigrationSucceed rollback:(void (^)())rollback onMigrationComplete:(void (^)(BOOL didComplete))onMigrationComplete {
-    
-    BOOL migrationSucceeded = NO;
+-(void)warmUpWithCompletionQueue:(dispatch_queue_t)completionQueue onWarmUpComplete:(void (^)(NSTimeInterval warmUpDuration))onWarmUpComplete {
     
-    BOOL shouldMigrate = testConditionsExistToMigrate();
+    dispatch_queue_t callbackQueue = completionQueue ?: dispatch_get_main_queue();
+    NSArray *hotQueries = [self.hotQueries copy];
+    size_t readerCount = (size_t)self.readerConnectionPoolSize;
     
-    if(shouldMigrate) {
+    dispatch_async(self.maintenanceQueue, ^{
+        uint64_t startTime = SQLiteQueryUtilTimestamp();
         
-        migrate();
+        // check out every pooled reader at once so each one is opened instead of the same idle one again
+        sqlite3 **readers = calloc(MAX(readerCount, 1), sizeof(sqlite3*));
+        dispatch_apply(readerCount, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^(size_t reader) {
+            int dbOpenResult = [self checkoutReaderDB:&readers[reader]];
+            if(dbOpenResult == SQLITE_OK) {
+                [self warmUpDB:readers[reader] hotQueries:hotQueries];
+            }
+            else {
+                NSLog(@"[SQLITE] Failed to open database %d %s", dbOpenResult, sqlite3_errmsg(readers[reader]));
+            }
+        });
+        for(size_t reader = 0; reader < readerCount; ++reader) {
+            [self checkinDB:readers[reader]];
+        }
+        free(readers);
         
-        migrationSucceeded = didMigrationSucceed();
+        sqlite3 *db = NULL;
+        int dbOpenResult = [self checkoutWriterDB:&db withOpenDB:^int(sqlite3 **writerDB) {
+            return [self openDBReadWrite:writerDB];
+        }];
+        if(dbOpenResult == SQLITE_OK) {
+            [self warmUpDB:db hotQueries:hotQueries];
+        }
+        [self checkinDB:db];
         
-        if(!migrationSucceeded) {
-            rollback();
+        NSTimeInterval warmUpDuration = SQLiteQueryUtilSecondsBetween(startTime, SQLiteQueryUtilTimestamp());
+        if(onWarmUpComplete) {
+            dispatch_async(callbackQueue, ^{
+                onWarmUpComplete(warmUpDuration);
+            });
         }
-    }
-    
-    onMigrationComplete(migrationSucceeded);
+    });
 }
 
--(BOOL)transaction:(BOOL (^)(sqlite3 **db))beginTransaction operationsInTransaction:(NSArray*)operationsInTransaction endTransaction:(BOOL (^)(BOOL transactionSucceeded, sqlite3 *db))endTransaction {
+-(void)warmUpDB:(sqlite3*)db hotQueries:(NSArray*)hotQueries {
     
-    sqlite3 *db = nil;
+    // parses the schema, otherwise the first prepare on the connection pays for it
+    sqlite3_exec(db, "SELECT count(*) FROM sqlite_master", NULL, NULL, NULL);
     
-    // beginTransaction opens the db and executes begin transaction
-    BOOL transactionSucceess = beginTransaction(&db);
+    // leaves the statements in the connection's statement cache
+    for(NSString *query in hotQueries) {
+        sqlite3_stmt *statement = NULL;
+        int prepareResponse = [self prepareStatement:&statement forQuery:query withDB:db];
+        if(prepareResponse != SQLITE_OK) {
+            NSLog(@"[SQLITE] Error preparing hot query %s", sqlite3_errmsg(db));
+            continue;
+        }
+        [self finalizeStatement:statement forQuery:query withDB:db];
+    }
     
-    if(transactionSucceess) {
-        
-        // allows results to be passed between operations
-        // ie insert row id result used as a foreign key in another statement
-        NSMutableDictionary *contextData = [[NSMutableDictionary alloc] init];
-        
-        for(SQLiteQueryUtilTransactionOperation nextOperation in operationsInTransaction) {
-            // TODO typecheck nextOperation | use wrapper object
-            transactionSucceess &= nextOperation(db, contextData);
-            
-            if(!transactionSucceess) {
-                break;
-            }
+    // pulls each index root and first leaf into the connection's page cache, not through queryDB: so timeToFirstQuery stays the caller's.
+    // partial indexes are skipped, INDEXED BY without their WHERE fails with no query solution
+    NSMutableArray *touchQueries = [[NSMutableArray alloc] init];
+    sqlite3_stmt *indexStatement = NULL;
+    const char *indexQuery = "SELECT m.name, m.tbl_name FROM sqlite_master m JOIN pragma_index_list(m.tbl_name) l ON l.name = m.name WHERE m.type = 'index' AND l.partial = 0";
+    if(sqlite3_prepare_v2(db, indexQuery, -1, &indexStatement, NULL) == SQLITE_OK) {
+        while(sqlite3_step(indexStatement) == SQLITE_ROW) {
+            NSString *index = SQLiteQueryUtilQuoteIdentifier([NSString stringWithUTF8String:(const char *)sqlite3_column_text(indexStatement, 0)]);
+            NSString *table = SQLiteQueryUtilQuoteIdentifier([NSString stringWithUTF8String:(const char *)sqlite3_column_text(indexStatement, 1)]);
+            [touchQueries addObject:[NSString stringWithFormat:@"SELECT 1 FROM %@ INDEXED BY %@ LIMIT 1", table, index]];
         }
     }
+    sqlite3_finalize(indexStatement);
     
-    // endTransaction executes commit/rollback and closes the db
-    transactionSucceess &= endTransaction(transactionSucceess, db);
+    for(NSString *touchQuery in touchQueries) {
+        sqlite3_exec(db, [touchQuery UTF8String], NULL, NULL, NULL);
+    }
+}
+
+-(void)registerScalarFunctionNamed:(NSString*)name argumentCount:(int)argumentCount options:(SQLiteQueryFunctionOptions)options function:(SQLiteQueryUtilFunctionBlock)function {
+    SQLiteQueryUtilFunction *registeredFunction = [[SQLiteQueryUtilFunction alloc] init];
+    registeredFunction.function = function;
+    [self registerFunction:registeredFunction named:name argumentCount:argumentCount options:options];
+}
+
+-(void)registerAggregateFunctionNamed:(NSString*)name argumentCount:(int)argumentCount options:(SQLiteQueryFunctionOptions)options step:(SQLiteQueryUtilFunctionBlock)step final:(SQLiteQueryUtilFunctionResultBlock)final {
+    SQLiteQueryUtilFunction *registeredFunction = [[SQLiteQueryUtilFunction alloc] init];
+    registeredFunction.step = step;
+    registeredFunction.final = final;
+    [self registerFunction:registeredFunction named:name argumentCount:argumentCount options:options];
+}
+
+-(void)registerWindowFunctionNamed:(NSString*)name argumentCount:(int)argumentCount options:(SQLiteQueryFunctionOptions)options step:(SQLiteQueryUtilFunctionBlock)step final:(SQLiteQueryUtilFunctionResultBlock)final value:(SQLiteQueryUtilFunctionResultBlock)value inverse:(SQLiteQueryUtilFunctionBlock)inverse {
+    SQLiteQueryUtilFunction *registeredFunction = [[SQLiteQueryUtilFunction alloc] init];
+    registeredFunction.step = step;
+    registeredFunction.final = final;
+    registeredFunction.value = value;
+    registeredFunction.inverse = inverse;
+    [self registerFunction:registeredFunction named:name argumentCount:argumentCount options:options];
+}
+
+-(void)registerFunction:(SQLiteQueryUtilFunction*)function named:(NSString*)name argumentCount:(int)argumentCount options:(SQLiteQueryFunctionOptions)options {
+    function.name = name;
+    function.argumentCount = argumentCount;
+    function.options = options;
     
-    return transactionSucceess;
+    @synchronized(self.functionsByKey) {
+        [self.functionsByKey setObject:function forKey:[NSString stringWithFormat:@"%@/%d", [name lowercaseString], argumentCount]];
+        ++self.functionGeneration;
+    }
 }
 
--(BOOL)createTransactionWithOperations:(NSArray*)operationsInTransaction {
-    return [self transactionWithOpenDB:^int(sqlite3 **db) {
-        return [self openForCreateDB:db];
-    } operations:operationsInTransaction];
+-(NSUInteger)currentFunctionGeneration {
+    @synchronized(self.functionsByKey) {
+        return self.functionGeneration;
+    }
 }
 
--(BOOL)writeTransactionWithOperations:(NSArray*)operationsInTransaction {
-    return [self transactionWithOpenDB:^int(sqlite3 **db) {
-        return [self openDBReadWrite:db];
-    } operations:operationsInTransaction];
+-(void)applyFunctionsToConnection:(SQLiteQueryConnection*)connection {
+    NSUInteger functionGeneration = [self currentFunctionGeneration];
+    
+    // checked in connections are only touched by their current holder, no lock needed past the generation read
+    if(connection.functionGeneration == functionGeneration) {
+        return;
+    }
+    [self applyFunctionsToDB:connection.db];
+    connection.functionGeneration = functionGeneration;
 }
 
--(BOOL)transactionWithOpenDB:(int (^)(sqlite3** db))opendb operations:(NSArray*)operationsInTransaction {
-    BOOL(^closedb)(sqlite3*) = ^BOOL(sqlite3 *db) {
-        int closeResult = closeResult = sqlite3_close(db);
-        BOOL closeSuccess = closeResult == SQLITE_OK;
-        if(closeResult != SQLITE_OK) {
-            NSLog(@"[SQLITE] Error failed to close db %d %s", closeResult, sqlite3_errmsg(db));
-        }
-        return closeSuccess;
-    };
+-(void)applyFunctionsToDB:(sqlite3*)db {
+    NSArray *functions = nil;
+    @synchronized(self.functionsByKey) {
+        functions = [self.functionsByKey allValues];
+    }
     
-    return [self transaction:^BOOL(sqlite3 **dbPtr){
-        sqlite3 *db = NULL;
-        int dbOpenResult = opendb(&db); // todo check opendb block ref strong/weak
-        *dbPtr = db;
-        
-        BOOL beginTransactionSuccess = dbOpenResult == SQLITE_OK;
-        
-        if (beginTransactionSuccess) {
-            // http://sqlite.org/lang_transaction.html
-            // IMMEDIATE (Rather than exclusive) allows readonly queries inside the transaction
-            // without error but changes (insert, update, delete) executed within the
-            // transaction are  not visible
-            int beginResponse = sqlite3_exec(db, "BEGIN IMMEDIATE TRANSACTION", 0, 0, 0);
-            beginTransactionSuccess &= beginResponse == SQLITE_OK;
-            if(beginResponse != SQLITE_OK) {
-                NSLog(@"[SQLITE] Begin Transaction Error: %d %s",beginResponse, sqlite3_errmsg(db));
-            }
+    for(SQLiteQueryUtilFunction *function in functions) {
+        int flags = SQLITE_UTF8;
+        if(function.options & SQLiteQueryFunctionOptionDeterministic) {
+            flags |= SQLITE_DETERMINISTIC;
         }
+#ifdef SQLITE_INNOCUOUS
+        if(function.options & SQLiteQueryFunctionOptionInnocuous) {
+            flags |= SQLITE_INNOCUOUS;
+        }
+#endif
+#ifdef SQLITE_DIRECTONLY
+        if(function.options & SQLiteQueryFunctionOptionDirectOnly) {
+            flags |= SQLITE_DIRECTONLY;
+        }
+#endif
         
-        return beginTransactionSuccess;
-        
-    } operationsInTransaction:operationsInTransaction endTransaction:^BOOL(BOOL transactionSucceeded, sqlite3 *db) {
-        BOOL wholeTransactionSucceeded = transactionSucceeded;
+        // the connection owns a reference, released by SQLiteQueryUtilFunctionDestroy
+        void *userData = (void *)CFBridgingRetain(function);
+        int createResult = SQLITE_OK;
         
-        if(!transactionSucceeded) {
-            int rollbackResponse = sqlite3_exec(db, "ROLLBACK", 0, 0, 0);
-            if (rollbackResponse != SQLITE_OK) {
-                NSLog(@"[SQLITE] Rollback Error: %d %s",rollbackResponse, sqlite3_errmsg(db));
+        if(function.inverse) {
+            if (@available(iOS 12.0, macOS 10.14, tvOS 12.0, watchOS 5.0, *)) {
+                createResult = sqlite3_create_window_function(db, [function.name UTF8String], function.argumentCount, flags, userData, SQLiteQueryUtilFunctionStep, SQLiteQueryUtilFunctionFinal, SQLiteQueryUtilFunctionValue, SQLiteQueryUtilFunctionInverse, SQLiteQueryUtilFunctionDestroy);
+            }
+            else {
+                CFBridgingRelease(userData);
+                createResult = SQLITE_MISUSE;
             }
         }
+        else if(function.step) {
+            createResult = sqlite3_create_function_v2(db, [function.name UTF8String], function.argumentCount, flags, userData, NULL, SQLiteQueryUtilFunctionStep, SQLiteQueryUtilFunctionFinal, SQLiteQueryUtilFunctionDestroy);
+        }
         else {
-            int commitResponse = sqlite3_exec(db, "COMMIT TRANSACTION", 0, 0, 0);
-            wholeTransactionSucceeded &= commitResponse == SQLITE_OK;
-            if (commitResponse != SQLITE_OK) {
-                NSLog(@"[SQLITE] Commit Transaction Error: %d %s",commitResponse, sqlite3_errmsg(db));
-            }
+            createResult = sqlite3_create_function_v2(db, [function.name UTF8String], function.argumentCount, flags, userData, SQLiteQueryUtilFunctionCall, NULL, NULL, SQLiteQueryUtilFunctionDestroy);
         }
         
-        wholeTransactionSucceeded &= closedb(db);
-        
-        return wholeTransactionSucceeded;
-    }];
+        if(createResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Failed to register function %@ %d %s", function.name, createResult, sqlite3_errmsg(db));
+        }
+    }
 }
 
 @end
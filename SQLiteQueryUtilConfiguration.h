@@ -0,0 +1,121 @@
+//
+// SQLiteQueryUtilConfiguration.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// PRAGMA profile applied to every connection SQLiteQueryUtil opens
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+@interface SQLiteQueryUtilConfiguration : NSObject <NSCopying>
+
+/**
+ PRAGMA journal_mode, ie @"WAL" or @"DELETE". nil leaves the database's mode
+ only applied to read|write connections since the mode is persisted in the database file
+ */
+@property (nonatomic, copy) NSString *journalMode;
+
+/**
+ PRAGMA synchronous, ie @"NORMAL" or @"FULL". nil leaves the sqlite default
+ */
+@property (nonatomic, copy) NSString *synchronous;
+
+/**
+ PRAGMA cache_size. positive values are pages, negative values are KiB. nil leaves the sqlite default
+ */
+@property (nonatomic, strong) NSNumber *cacheSize;
+
+/**
+ PRAGMA mmap_size in bytes. nil leaves the sqlite default
+ */
+@property (nonatomic, strong) NSNumber *mmapSize;
+
+/**
+ PRAGMA mmap_size in bytes for read only connections, overrides mmapSize. nil uses mmapSize
+ */
+@property (nonatomic, strong) NSNumber *readerMmapSize;
+
+/**
+ PRAGMA mmap_size in bytes for the read|write connection, overrides mmapSize. nil uses mmapSize
+ */
+@property (nonatomic, strong) NSNumber *writerMmapSize;
+
+/**
+ open read only connections with the 'immutable=1' uri parameter, sqlite skips all locking and change detection
+ only for databases nothing ever writes to, ie one shipped in the app bundle. writes through SQLiteQueryUtil fail
+ */
+@property (nonatomic, assign) BOOL immutable;
+
+/**
+ PRAGMA temp_store, ie @"MEMORY" or @"FILE". nil leaves the sqlite default
+ */
+@property (nonatomic, copy) NSString *tempStore;
+
+/**
+ seconds sqlite waits on a locked database before returning SQLITE_BUSY. 0 does not wait
+ on a SQLiteQueryUtil's pooled connections it becomes the default busyRetryDeadline of the backoff busy handler
+ */
+@property (nonatomic, assign) NSTimeInterval busyTimeout;
+
+/**
+ WAL with synchronous=FULL, every commit survives power loss
+ 
+ @return newly-initialized SQLiteQueryUtilConfiguration
+ */
++(instancetype)durableConfiguration;
+
+/**
+ WAL with synchronous=NORMAL, in memory temp tables and a larger page cache
+ a commit may roll back after power loss but the database stays consistent
+ 
+ @return newly-initialized SQLiteQueryUtilConfiguration
+ */
++(instancetype)throughputConfiguration;
+
+/**
+ WAL with synchronous=NORMAL, a large page cache and memory mapped reads on the read only connections
+ 
+ @return newly-initialized SQLiteQueryUtilConfiguration
+ */
++(instancetype)readMostlyConfiguration;
+
+/**
+ immutable read only access to a database that never changes, a large page cache and memory mapped reads
+ 
+ @return newly-initialized SQLiteQueryUtilConfiguration
+ */
++(instancetype)bundledReadOnlyConfiguration;
+
+/**
+ executes the configured PRAGMAs on a newly opened connection
+ 
+ @param db open database connection
+ @param readOnly db was opened read only, journal_mode is skipped and readerMmapSize used over writerMmapSize
+ 
+ @return sqlite result of the first PRAGMA that failed or SQLITE_OK
+ */
+-(int)applyToDB:(sqlite3*)db readOnly:(BOOL)readOnly;
+
+@end
@@ -0,0 +1,122 @@
+//
+// SQLiteQueryUtilConfiguration.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryUtilConfiguration.h"
+
+@implementation SQLiteQueryUtilConfiguration
+
++(instancetype)durableConfiguration {
+    SQLiteQueryUtilConfiguration *configuration = [[self alloc] init];
+    configuration.journalMode = @"WAL";
+    configuration.synchronous = @"FULL";
+    configuration.busyTimeout = 5.0;
+    return configuration;
+}
+
++(instancetype)throughputConfiguration {
+    SQLiteQueryUtilConfiguration *configuration = [[self alloc] init];
+    configuration.journalMode = @"WAL";
+    configuration.synchronous = @"NORMAL";
+    configuration.cacheSize = @(-8192); // 8MB
+    configuration.tempStore = @"MEMORY";
+    configuration.busyTimeout = 2.0;
+    return configuration;
+}
+
++(instancetype)readMostlyConfiguration {
+    SQLiteQueryUtilConfiguration *configuration = [[self alloc] init];
+    configuration.journalMode = @"WAL";
+    configuration.synchronous = @"NORMAL";
+    configuration.cacheSize = @(-16384); // 16MB
+    // writes go through the page cache either way, only the readers gain from the mapping
+    configuration.readerMmapSize = @(256 * 1024 * 1024);
+    configuration.tempStore = @"MEMORY";
+    configuration.busyTimeout = 2.0;
+    return configuration;
+}
+
++(instancetype)bundledReadOnlyConfiguration {
+    SQLiteQueryUtilConfiguration *configuration = [[self alloc] init];
+    configuration.cacheSize = @(-16384); // 16MB
+    configuration.readerMmapSize = @(256 * 1024 * 1024);
+    configuration.tempStore = @"MEMORY";
+    configuration.immutable = YES;
+    return configuration;
+}
+
+-(id)copyWithZone:(NSZone *)zone {
+    SQLiteQueryUtilConfiguration *configuration = [[[self class] allocWithZone:zone] init];
+    configuration.journalMode = self.journalMode;
+    configuration.synchronous = self.synchronous;
+    configuration.cacheSize = self.cacheSize;
+    configuration.mmapSize = self.mmapSize;
+    configuration.readerMmapSize = self.readerMmapSize;
+    configuration.writerMmapSize = self.writerMmapSize;
+    configuration.immutable = self.immutable;
+    configuration.tempStore = self.tempStore;
+    configuration.busyTimeout = self.busyTimeout;
+    return configuration;
+}
+
+-(int)applyToDB:(sqlite3*)db readOnly:(BOOL)readOnly {
+    int firstFailure = SQLITE_OK;
+    
+    if(self.busyTimeout > 0) {
+        sqlite3_busy_timeout(db, (int)(self.busyTimeout * 1000));
+    }
+    
+    NSMutableArray *pragmas = [[NSMutableArray alloc] init];
+    if(self.journalMode && !readOnly) {
+        [pragmas addObject:[NSString stringWithFormat:@"PRAGMA journal_mode=%@;", self.journalMode]];
+    }
+    if(self.synchronous) {
+        [pragmas addObject:[NSString stringWithFormat:@"PRAGMA synchronous=%@;", self.synchronous]];
+    }
+    if(self.cacheSize) {
+        [pragmas addObject:[NSString stringWithFormat:@"PRAGMA cache_size=%lld;", [self.cacheSize longLongValue]]];
+    }
+    NSNumber *mmapSize = (readOnly ? self.readerMmapSize : self.writerMmapSize) ?: self.mmapSize;
+    if(mmapSize) {
+        [pragmas addObject:[NSString stringWithFormat:@"PRAGMA mmap_size=%lld;", [mmapSize longLongValue]]];
+    }
+    if(self.tempStore) {
+        [pragmas addObject:[NSString stringWithFormat:@"PRAGMA temp_store=%@;", self.tempStore]];
+    }
+    
+    for(NSString *pragma in pragmas) {
+        int pragmaResult = sqlite3_exec(db, [pragma UTF8String], 0, 0, 0);
+        if(pragmaResult != SQLITE_OK) {
+            NSLog(@"[SQLITE] Error applying %@ %d %s", pragma, pragmaResult, sqlite3_errmsg(db));
+            if(firstFailure == SQLITE_OK) {
+                firstFailure = pragmaResult;
+            }
+        }
+    }
+    
+    return firstFailure;
+}
+
+@end
@@ -0,0 +1,264 @@
+//
+// SQLiteQueryUtilMetrics.h
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// Per statement timing reported by SQLiteQueryUtil instrumentation
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+
+@interface SQLiteQueryStatementMetrics : NSObject
+
+/**
+ sqlite query that was executed
+ */
+@property (nonatomic, copy) NSString *query;
+
+/**
+ YES for writeQueryInDB: executions
+ */
+@property (nonatomic, assign) BOOL isWriteQuery;
+
+/**
+ seconds spent opening or checking out the connection
+ */
+@property (nonatomic, assign) NSTimeInterval openDuration;
+
+/**
+ seconds spent preparing the statement, near 0 on a statement cache hit
+ */
+@property (nonatomic, assign) NSTimeInterval prepareDuration;
+
+/**
+ number of sqlite3_step calls
+ */
+@property (nonatomic, assign) NSUInteger stepCount;
+
+/**
+ number of rows returned
+ */
+@property (nonatomic, assign) NSUInteger rowCount;
+
+/**
+ seconds from open to close including the row callbacks
+ */
+@property (nonatomic, assign) NSTimeInterval totalDuration;
+
+/**
+ sqlite result of the last step, SQLITE_DONE on success
+ */
+@property (nonatomic, assign) int resultCode;
+
+/**
+ number of times the busy handler waited on a locked database during the statement
+ */
+@property (nonatomic, assign) NSUInteger busyRetryCount;
+
+/**
+ EXPLAIN QUERY PLAN detail lines, only captured when totalDuration reached slowQueryThreshold
+ */
+@property (nonatomic, copy) NSString *queryPlan;
+
+@end
+
+@interface SQLiteQueryTransactionMetrics : NSObject
+
+/**
+ number of times the whole transaction was run, more than 1 when it was retried after SQLITE_BUSY
+ */
+@property (nonatomic, assign) NSUInteger attemptCount;
+
+/**
+ number of times the busy handler waited on a locked database across all attempts
+ */
+@property (nonatomic, assign) NSUInteger busyRetryCount;
+
+/**
+ seconds from the first begin to the last commit or rollback
+ */
+@property (nonatomic, assign) NSTimeInterval totalDuration;
+
+/**
+ extended sqlite result that failed the last attempt, SQLITE_OK when committed
+ */
+@property (nonatomic, assign) int resultCode;
+
+/**
+ YES when the transaction committed
+ */
+@property (nonatomic, assign) BOOL succeeded;
+
+@end
+
+@interface SQLiteQueryMemoryStatus : NSObject
+
+/**
+ bytes sqlite has allocated across the process, sqlite3_status64 SQLITE_STATUS_MEMORY_USED
+ */
+@property (nonatomic, assign) sqlite3_int64 memoryUsed;
+
+/**
+ highest memoryUsed since the process started
+ */
+@property (nonatomic, assign) sqlite3_int64 memoryHighwater;
+
+/**
+ bytes of page cache used by the pooled connections and the writer, sqlite3_db_status SQLITE_DBSTATUS_CACHE_USED
+ */
+@property (nonatomic, assign) sqlite3_int64 pageCacheUsed;
+
+/**
+ bytes held by prepared statements on those connections, SQLITE_DBSTATUS_STMT_USED
+ */
+@property (nonatomic, assign) sqlite3_int64 statementMemoryUsed;
+
+/**
+ bytes held by parsed schemas on those connections, SQLITE_DBSTATUS_SCHEMA_USED
+ */
+@property (nonatomic, assign) sqlite3_int64 schemaMemoryUsed;
+
+/**
+ page cache hits and misses on those connections, SQLITE_DBSTATUS_CACHE_HIT and SQLITE_DBSTATUS_CACHE_MISS
+ */
+@property (nonatomic, assign) sqlite3_int64 pageCacheHitCount;
+@property (nonatomic, assign) sqlite3_int64 pageCacheMissCount;
+
+/**
+ number of connections measured, checked out readers count with their status at checkout since they belong to another thread
+ */
+@property (nonatomic, assign) NSUInteger connectionCount;
+
+@end
+
+@interface SQLiteQueryCheckpointMetrics : NSObject
+
+/**
+ SQLITE_CHECKPOINT_PASSIVE, SQLITE_CHECKPOINT_RESTART or SQLITE_CHECKPOINT_TRUNCATE
+ */
+@property (nonatomic, assign) int mode;
+
+/**
+ bytes in the -wal file before the checkpoint
+ */
+@property (nonatomic, assign) unsigned long long walSizeBefore;
+
+/**
+ frames in the wal after the checkpoint, 0 after a truncate
+ */
+@property (nonatomic, assign) int walFrameCount;
+
+/**
+ frames copied back into the database, fewer than walFrameCount when readers held older frames
+ */
+@property (nonatomic, assign) int checkpointedFrameCount;
+
+/**
+ seconds the checkpoint took
+ */
+@property (nonatomic, assign) NSTimeInterval totalDuration;
+
+/**
+ sqlite result of sqlite3_wal_checkpoint_v2, SQLITE_BUSY when readers or the writer held it up
+ */
+@property (nonatomic, assign) int resultCode;
+
+@end
+
+// keys of a SQLiteQueryLatencyRecorder summary entry, NSNumber values
+extern NSString * const SQLiteQueryLatencyCountKey;
+extern NSString * const SQLiteQueryLatencyOpsPerSecondKey;
+extern NSString * const SQLiteQueryLatencyP50Key;
+extern NSString * const SQLiteQueryLatencyP99Key;
+// only for labels timed with measureLabel:iterations:block:
+extern NSString * const SQLiteQueryLatencyPeakMemoryKey;
+extern NSString * const SQLiteQueryLatencyPeakAllocationsKey;
+
+// below this many samples p99 is just the slowest run, regressionsAgainstBaseline:tolerance: skips such labels
+static const NSUInteger SQLiteQueryLatencyMinimumSampleCount = 100;
+
+/**
+ collects durations per label and reports ops/sec, p50/p99 latency and sqlite allocations
+ 
+ feed it from statementMetricsHandler or time blocks with measureLabel:iterations:block:
+ a summary can be stored and later passed back as the baseline to catch regressions.
+ percentiles are nearest rank, record at least SQLiteQueryLatencyMinimumSampleCount durations per label
+ for p99 to differ from the maximum
+ */
+@interface SQLiteQueryLatencyRecorder : NSObject
+
+/**
+ records one duration for label
+ 
+ @param duration seconds
+ @param label name of the operation measured
+ */
+-(void)recordDuration:(NSTimeInterval)duration forLabel:(NSString*)label;
+
+/**
+ records metrics.totalDuration labelled with metrics.query
+ 
+ @param metrics metrics from statementMetricsHandler
+ */
+-(void)recordStatementMetrics:(SQLiteQueryStatementMetrics*)metrics;
+
+/**
+ times block iterations times and records each run under label
+ 
+ also records the most bytes and outstanding allocations sqlite reached above the start of any run, from the
+ sqlite3_status64 SQLITE_STATUS_MEMORY_USED and SQLITE_STATUS_MALLOC_COUNT highwaters. those process wide highwaters
+ are reset before each run so SQLiteQueryMemoryStatus memoryHighwater only covers the time since, and allocations by
+ other threads running at the same time are counted too
+ 
+ @param label name of the operation measured
+ @param iterations number of times to run block, at least SQLiteQueryLatencyMinimumSampleCount for a meaningful p99
+ @param block operation to measure
+ */
+-(void)measureLabel:(NSString*)label iterations:(NSUInteger)iterations block:(void (^)(void))block;
+
+/**
+ label -> dictionary of SQLiteQueryLatency*Key values. property list compatible
+ 
+ @return summary of everything recorded
+ */
+-(NSDictionary*)summary;
+
+/**
+ labels whose p99 latency grew more than tolerance over baseline
+ 
+ labels with fewer than SQLiteQueryLatencyMinimumSampleCount samples now or in baseline are not compared
+ 
+ @param baseline an earlier summary
+ @param tolerance allowed growth, ie 0.1 for 10%
+ 
+ @return labels that regressed, empty if none
+ */
+-(NSArray*)regressionsAgainstBaseline:(NSDictionary*)baseline tolerance:(double)tolerance;
+
+/**
+ discards everything recorded
+ */
+-(void)reset;
+
+@end
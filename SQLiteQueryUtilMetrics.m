@@ -0,0 +1,214 @@
+//
+// SQLiteQueryUtilMetrics.m
+// https://github.com/DietCoder/SQLiteQueryUtil
+//
+// License: The MIT License (MIT)
+//
+// Copyright (c) 2014 DietCoder
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "SQLiteQueryUtilMetrics.h"
+
+@implementation SQLiteQueryStatementMetrics
+
+-(NSString*)description {
+    return [NSString stringWithFormat:@"<%@ total %.3fms open %.3fms prepare %.3fms steps %lu rows %lu busy retries %lu result %d %@>", NSStringFromClass([self class]), self.totalDuration * 1000, self.openDuration * 1000, self.prepareDuration * 1000, (unsigned long)self.stepCount, (unsigned long)self.rowCount, (unsigned long)self.busyRetryCount, self.resultCode, self.query];
+}
+
+@end
+
+@implementation SQLiteQueryTransactionMetrics
+
+-(NSString*)description {
+    return [NSString stringWithFormat:@"<%@ total %.3fms attempts %lu busy retries %lu result %d %@>", NSStringFromClass([self class]), self.totalDuration * 1000, (unsigned long)self.attemptCount, (unsigned long)self.busyRetryCount, self.resultCode, self.succeeded ? @"committed" : @"rolled back"];
+}
+
+@end
+
+@implementation SQLiteQueryMemoryStatus
+
+-(NSString*)description {
+    return [NSString stringWithFormat:@"<%@ used %lld highwater %lld page cache %lld statements %lld schema %lld cache hits %lld misses %lld connections %lu>", NSStringFromClass([self class]), self.memoryUsed, self.memoryHighwater, self.pageCacheUsed, self.statementMemoryUsed, self.schemaMemoryUsed, self.pageCacheHitCount, self.pageCacheMissCount, (unsigned long)self.connectionCount];
+}
+
+@end
+
+@implementation SQLiteQueryCheckpointMetrics
+
+-(NSString*)description {
+    return [NSString stringWithFormat:@"<%@ total %.3fms mode %d wal %llu bytes frames %d checkpointed %d result %d>", NSStringFromClass([self class]), self.totalDuration * 1000, self.mode, self.walSizeBefore, self.walFrameCount, self.checkpointedFrameCount, self.resultCode];
+}
+
+@end
+
+NSString * const SQLiteQueryLatencyCountKey = @"count";
+NSString * const SQLiteQueryLatencyOpsPerSecondKey = @"opsPerSecond";
+NSString * const SQLiteQueryLatencyP50Key = @"p50";
+NSString * const SQLiteQueryLatencyP99Key = @"p99";
+NSString * const SQLiteQueryLatencyPeakMemoryKey = @"peakMemory";
+NSString * const SQLiteQueryLatencyPeakAllocationsKey = @"peakAllocations";
+
+static int SQLiteQueryLatencyCompare(const void *a, const void *b) {
+    double lhs = *(const double *)a;
+    double rhs = *(const double *)b;
+    return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+}
+
+@interface SQLiteQueryLatencyRecorder()
+// label -> NSMutableData of doubles, unboxed so recording stays cheap
+@property (nonatomic, strong) NSMutableDictionary *durationsByLabel;
+// label -> @[peak bytes, peak allocations] over every measured run
+@property (nonatomic, strong) NSMutableDictionary *allocationPeaksByLabel;
+@end
+
+@implementation SQLiteQueryLatencyRecorder
+
+-(id)init {
+    if(self = [super init]) {
+        self.durationsByLabel = [[NSMutableDictionary alloc] init];
+        self.allocationPeaksByLabel = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+-(void)recordDuration:(NSTimeInterval)duration forLabel:(NSString*)label {
+    if(![label isKindOfClass:[NSString class]]) {
+        return;
+    }
+    
+    @synchronized(self) {
+        NSMutableData *durations = [self.durationsByLabel objectForKey:label];
+        if(!durations) {
+            durations = [[NSMutableData alloc] init];
+            [self.durationsByLabel setObject:durations forKey:label];
+        }
+        [durations appendBytes:&duration length:sizeof(duration)];
+    }
+}
+
+-(void)recordStatementMetrics:(SQLiteQueryStatementMetrics*)metrics {
+    [self recordDuration:metrics.totalDuration forLabel:metrics.query];
+}
+
+-(void)measureLabel:(NSString*)label iterations:(NSUInteger)iterations block:(void (^)(void))block {
+    if(!block) {
+        return;
+    }
+    
+    sqlite3_int64 peakMemory = 0;
+    sqlite3_int64 peakAllocations = 0;
+    for(NSUInteger i = 0; i < iterations; ++i) {
+        @autoreleasepool {
+            // resetting makes the highwater start at the current value
+            sqlite3_int64 startMemory = 0, startAllocations = 0, highwater = 0;
+            sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &startMemory, &highwater, 1);
+            sqlite3_status64(SQLITE_STATUS_MALLOC_COUNT, &startAllocations, &highwater, 1);
+            
+            CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+            block();
+            [self recordDuration:CFAbsoluteTimeGetCurrent() - start forLabel:label];
+            
+            sqlite3_int64 current = 0;
+            sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &highwater, 0);
+            peakMemory = MAX(peakMemory, highwater - startMemory);
+            sqlite3_status64(SQLITE_STATUS_MALLOC_COUNT, &current, &highwater, 0);
+            peakAllocations = MAX(peakAllocations, highwater - startAllocations);
+        }
+    }
+    
+    if(iterations > 0 && [label isKindOfClass:[NSString class]]) {
+        @synchronized(self) {
+            NSArray *previousPeaks = [self.allocationPeaksByLabel objectForKey:label];
+            peakMemory = MAX(peakMemory, [[previousPeaks firstObject] longLongValue]);
+            peakAllocations = MAX(peakAllocations, [[previousPeaks lastObject] longLongValue]);
+            [self.allocationPeaksByLabel setObject:@[@(peakMemory), @(peakAllocations)] forKey:label];
+        }
+    }
+}
+
+-(NSDictionary*)summary {
+    NSMutableDictionary *summary = [[NSMutableDictionary alloc] init];
+    
+    @synchronized(self) {
+        [self.durationsByLabel enumerateKeysAndObjectsUsingBlock:^(NSString *label, NSMutableData *durations, BOOL *stop) {
+            NSUInteger count = [durations length] / sizeof(double);
+            if(count == 0) {
+                return;
+            }
+            
+            NSMutableData *sortedDurations = [durations mutableCopy];
+            double *values = (double *)[sortedDurations mutableBytes];
+            qsort(values, count, sizeof(double), SQLiteQueryLatencyCompare);
+            
+            double total = 0;
+            for(NSUInteger i = 0; i < count; ++i) {
+                total += values[i];
+            }
+            
+            NSMutableDictionary *entry = [@{SQLiteQueryLatencyCountKey: @(count),
+                                            SQLiteQueryLatencyOpsPerSecondKey: @(total > 0 ? count / total : 0),
+                                            SQLiteQueryLatencyP50Key: @(values[(count - 1) / 2]),
+                                            SQLiteQueryLatencyP99Key: @(values[(NSUInteger)((count - 1) * 0.99)])} mutableCopy];
+            NSArray *allocationPeaks = [self.allocationPeaksByLabel objectForKey:label];
+            if(allocationPeaks) {
+                [entry setObject:[allocationPeaks firstObject] forKey:SQLiteQueryLatencyPeakMemoryKey];
+                [entry setObject:[allocationPeaks lastObject] forKey:SQLiteQueryLatencyPeakAllocationsKey];
+            }
+            [summary setObject:entry forKey:label];
+        }];
+    }
+    
+    return summary;
+}
+
+-(NSArray*)regressionsAgainstBaseline:(NSDictionary*)baseline tolerance:(double)tolerance {
+    NSMutableArray *regressions = [[NSMutableArray alloc] init];
+    NSDictionary *summary = [self summary];
+    
+    [summary enumerateKeysAndObjectsUsingBlock:^(NSString *label, NSDictionary *current, BOOL *stop) {
+        NSDictionary *previous = [baseline objectForKey:label];
+        if(![previous isKindOfClass:[NSDictionary class]]) {
+            return;
+        }
+        
+        // too few samples and p99 is a single outlier
+        if([[previous objectForKey:SQLiteQueryLatencyCountKey] unsignedIntegerValue] < SQLiteQueryLatencyMinimumSampleCount ||
+           [[current objectForKey:SQLiteQueryLatencyCountKey] unsignedIntegerValue] < SQLiteQueryLatencyMinimumSampleCount) {
+            return;
+        }
+        
+        double previousP99 = [[previous objectForKey:SQLiteQueryLatencyP99Key] doubleValue];
+        double currentP99 = [[current objectForKey:SQLiteQueryLatencyP99Key] doubleValue];
+        if(previousP99 > 0 && currentP99 > previousP99 * (1.0 + tolerance)) {
+            [regressions addObject:label];
+        }
+    }];
+    
+    return regressions;
+}
+
+-(void)reset {
+    @synchronized(self) {
+        [self.durationsByLabel removeAllObjects];
+        [self.allocationPeaksByLabel removeAllObjects];
+    }
+}
+
+@end